@@ -0,0 +1,378 @@
+#!/usr/bin/env python3
+"""
+Latency benchmark for the MQTT -> Wemos -> Pico -> device path, and for the
+sensor telemetry path back to the broker.
+
+Publishes device commands at a fixed rate, alternating between values so
+each one is a real change on the Pico, and collects what the boards report
+with LATENCY_TRACE set to 1:
+  L%d=a,b,c;  Pico, us: UART line to core1 pickup, pickup to output written, total
+  W%d=t;      Wemos, ms: MQTT callback to the Pico echoing the new device value
+  WS=t;       Wemos, ms: first sensor line of a cycle to the datapoint publish
+plus its own round trip, command publish to the device status topic update.
+Prints p50/p99/max per metric and the command throughput, and exits with 1
+if any --gate is exceeded, so it can gate a firmware release.
+
+With --host-firmware, the Pico and Wemos firmware built for Linux (cmake -S
+host) run as child processes against a broker stand-in in this one, so the
+firmware's command and telemetry paths, and the benchmark, can be checked
+without hardware. Host timings are not board timings.
+
+Requires paho-mqtt (pip install paho-mqtt).
+
+Examples:
+  latency_bench.py --host broker.example --port 8883 --tls -u user -P pass \
+      --rate 0.5 --count 200 --gate W0:p99:2000
+  latency_bench.py --host-firmware build-host --rate 1 --count 20 --sensor-cycles 3 \
+      --timer-period-ms 500
+"""
+
+import argparse
+import asyncio
+import os
+import re
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+DEVICE_TOPICS = {0: "devices/LED_0", 1: "devices/digipot_0"}
+TOPIC_LATENCY = "bench/latency"
+TOPIC_PICO_STATUS = "pico/status"
+
+LATENCY_L = re.compile(r"L(\d+)=(\d+),(\d+),(\d+);")
+LATENCY_W = re.compile(r"W(\d+)=(\d+);")
+LATENCY_WS = re.compile(r"WS=(\d+);")
+DEVICE_STATUS = re.compile(r'"DeviceIndex":(\d+),"DeviceValue":(\d+)')
+
+
+def percentile(values, p):
+    """nearest-rank percentile of a non-empty list"""
+    ordered = sorted(values)
+    rank = max(1, -(-len(ordered) * p // 100))
+    return ordered[int(rank) - 1]
+
+
+class Results:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.metrics = {}  # name -> list of ms
+        self.acked = 0
+        self.denied = 0
+        self.first_sent = None
+        self.last_acked = None
+        self.last_message = 0  # last report about a command
+
+    def add(self, name, ms):
+        with self.lock:
+            self.metrics.setdefault(name, []).append(ms)
+
+    def summary(self):
+        rows = []
+        for name in sorted(self.metrics):
+            v = self.metrics[name]
+            rows.append((name, len(v), percentile(v, 50), percentile(v, 99), max(v)))
+        return rows
+
+
+class Driver:
+    def __init__(self, args, results):
+        self.args = args
+        self.results = results
+        self.pending = {}  # device value -> publish time, for the device status round trip
+        self.values = [int(v) for v in args.values.split(",")]
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2,
+                                  client_id="latency-bench-%d" % int(time.time()))
+        if args.username:
+            self.client.username_pw_set(args.username, args.password)
+        if args.tls:
+            self.client.tls_set()
+        self.client.on_message = self.on_message
+        self.connected = threading.Event()
+        self.client.on_connect = lambda c, u, f, rc, p: self.connected.set()
+
+    def start(self, host, port):
+        self.client.connect(host, port)
+        self.client.loop_start()
+        if not self.connected.wait(10):
+            raise SystemExit("could not connect to %s:%d" % (host, port))
+        status = DEVICE_TOPICS[self.args.device] + "/status"
+        self.client.subscribe([(TOPIC_LATENCY, 0), (status, 0), (TOPIC_PICO_STATUS, 0)])
+
+    def on_message(self, client, userdata, msg):
+        now = time.monotonic()
+        text = msg.payload.decode(errors="replace")
+        r = self.results
+        if msg.topic == TOPIC_LATENCY:
+            m = LATENCY_L.match(text)
+            if m:
+                r.last_message = now
+                i = m.group(1)
+                r.add("L%s.uart_to_core1" % i, int(m.group(2)) / 1000)
+                r.add("L%s.core1_to_output" % i, int(m.group(3)) / 1000)
+                r.add("L%s.total" % i, int(m.group(4)) / 1000)
+            m = LATENCY_W.match(text)
+            if m:
+                r.last_message = now
+                r.add("W%s" % m.group(1), int(m.group(2)))
+            m = LATENCY_WS.match(text)
+            if m:
+                r.add("WS", int(m.group(1)))
+        elif msg.topic == TOPIC_PICO_STATUS:
+            if "SERVICE DENIED" in text:
+                r.last_message = now
+                with r.lock:
+                    r.denied += 1
+        else:
+            m = DEVICE_STATUS.search(text)
+            if m and int(m.group(1)) == self.args.device:
+                sent = self.pending.pop(int(m.group(2)), None)
+                if sent is not None:
+                    r.last_message = now
+                    r.add("E%d" % self.args.device, (now - sent) * 1000)
+                    with r.lock:
+                        r.acked += 1
+                        r.last_acked = now
+
+    def run(self):
+        topic = DEVICE_TOPICS[self.args.device] + "/value"
+        period = 1.0 / self.args.rate
+        start = time.monotonic()
+        self.results.first_sent = start
+        for n in range(self.args.count):
+            value = self.values[n % len(self.values)]
+            self.pending[value] = time.monotonic()
+            self.client.publish(topic, "D%d=%d;" % (self.args.device, value))
+            delay = start + (n + 1) * period - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+
+        # wait for the last echoes and the requested sensor cycles; denied
+        # commands never echo, so quiet for a few periods also ends the wait
+        r = self.results
+        sent = time.monotonic()
+        deadline = sent + self.args.timeout
+        quiet = max(3.0, 2 * period)
+        while time.monotonic() < deadline:
+            now = time.monotonic()
+            sensors_done = len(r.metrics.get("WS", [])) >= self.args.sensor_cycles
+            commands_done = (r.acked + r.denied >= self.args.count
+                             or now - max(r.last_message, sent) > quiet)
+            if sensors_done and commands_done:
+                break
+            time.sleep(0.05)
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def report(args, results):
+    rows = results.summary()
+    print("%-22s %6s %10s %10s %10s" % ("metric (ms)", "n", "p50", "p99", "max"))
+    for name, n, p50, p99, mx in rows:
+        print("%-22s %6d %10.1f %10.1f %10.1f" % (name, n, p50, p99, mx))
+    if results.acked and results.last_acked:
+        elapsed = results.last_acked - results.first_sent
+        print("commands: %d sent, %d acked, %d denied, %.2f acked/s"
+              % (args.count, results.acked, results.denied, results.acked / elapsed if elapsed else 0))
+    else:
+        print("commands: %d sent, 0 acked, %d denied" % (args.count, results.denied))
+
+    failed = False
+    metrics = results.metrics
+    for gate in args.gate:
+        name, stat, limit = gate.split(":")
+        v = metrics.get(name)
+        if not v:
+            print("GATE %s: no samples" % gate)
+            failed = True
+            continue
+        value = max(v) if stat == "max" else percentile(v, int(stat.lstrip("p")))
+        ok = value <= float(limit)
+        print("GATE %s: %.1f %s" % (gate, value, "ok" if ok else "FAILED"))
+        failed |= not ok
+    if results.acked < args.count * args.min_acked / 100:
+        print("GATE acked >= %d%%: FAILED" % args.min_acked)
+        failed = True
+    return 1 if failed else 0
+
+
+#### broker stand-in and host firmware, for --host-firmware ####
+
+class StandInBroker:
+    """MQTT 3.1.1 broker, QoS 0 and retained messages only, on localhost"""
+
+    def __init__(self):
+        self.subs = []  # (filter, writer)
+        self.retained = {}
+        self.loop = asyncio.new_event_loop()
+        sock = socket.socket()
+        sock.bind(("127.0.0.1", 0))
+        sock.listen(16)  # clients may connect before the server task runs
+        self.port = sock.getsockname()[1]
+        self.sock = sock
+        threading.Thread(target=self._run, daemon=True).start()
+
+    def _run(self):
+        asyncio.set_event_loop(self.loop)
+        self.loop.run_until_complete(asyncio.start_server(self._client, sock=self.sock))
+        self.loop.run_forever()
+
+    @staticmethod
+    def matches(filt, topic):
+        f, t = filt.split("/"), topic.split("/")
+        for i, part in enumerate(f):
+            if part == "#":
+                return True
+            if i >= len(t) or (part != "+" and part != t[i]):
+                return False
+        return len(f) == len(t)
+
+    @staticmethod
+    def packet(kind, body):
+        n, length = len(body), b""
+        while True:
+            b = n % 128
+            n //= 128
+            length += bytes([b | (0x80 if n else 0)])
+            if not n:
+                return bytes([kind]) + length + body
+
+    def publish_packet(self, topic, payload, retain=False):
+        t = topic.encode()
+        return self.packet(0x30 | (1 if retain else 0), struct.pack("!H", len(t)) + t + payload)
+
+    async def _client(self, reader, writer):
+        try:
+            while True:
+                head = await reader.readexactly(1)
+                n, mult = 0, 1
+                while True:
+                    b = (await reader.readexactly(1))[0]
+                    n += (b & 0x7F) * mult
+                    mult *= 128
+                    if not b & 0x80:
+                        break
+                body = await reader.readexactly(n)
+                kind = head[0] >> 4
+                if kind == 1:  # CONNECT
+                    writer.write(self.packet(0x20, b"\x00\x00"))
+                elif kind == 3:  # PUBLISH
+                    qos = (head[0] >> 1) & 3
+                    tl = struct.unpack("!H", body[:2])[0]
+                    topic = body[2:2 + tl].decode()
+                    rest = body[2 + tl:]
+                    if qos:
+                        writer.write(self.packet(0x40, rest[:2]))
+                        rest = rest[2:]
+                    if head[0] & 1:
+                        self.retained[topic] = rest
+                    out = self.publish_packet(topic, rest)
+                    for filt, w in list(self.subs):
+                        if self.matches(filt, topic):
+                            w.write(out)
+                elif kind == 8:  # SUBSCRIBE
+                    pid, i, granted = body[:2], 2, b""
+                    while i < len(body):
+                        tl = struct.unpack("!H", body[i:i + 2])[0]
+                        filt = body[i + 2:i + 2 + tl].decode()
+                        i += 3 + tl
+                        self.subs.append((filt, writer))
+                        granted += b"\x00"
+                        for topic, payload in self.retained.items():
+                            if self.matches(filt, topic):
+                                writer.write(self.publish_packet(topic, payload, True))
+                    writer.write(self.packet(0x90, pid + granted))
+                elif kind == 12:  # PINGREQ
+                    writer.write(self.packet(0xD0, b""))
+                elif kind == 14:  # DISCONNECT
+                    break
+                await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        self.subs = [(f, w) for f, w in self.subs if w is not writer]
+        writer.close()
+
+
+class HostFirmware:
+    """the Pico and Wemos firmware built for the host (see host/), joined by a
+    socketpair as their UART and publishing to the broker stand-in"""
+
+    def __init__(self, port, args):
+        pico_end, wemos_end = socket.socketpair()
+        pico = [os.path.join(args.host_firmware, "pico_host"), "--uart-fd", str(pico_end.fileno())]
+        if args.timer_period_ms:
+            pico += ["--timer-period-ms", str(args.timer_period_ms)]
+        wemos = [os.path.join(args.host_firmware, "wemos_host"), "--uart-fd", str(wemos_end.fileno()),
+                 "--broker", "127.0.0.1:%d" % port]
+        # the Wemos publishes the initial device values once it has subscribed
+        up = threading.Event()
+        watch = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id="host-firmware-watch")
+        watch.on_message = lambda c, u, msg: up.set()
+        watch.connect("127.0.0.1", port)
+        watch.subscribe(DEVICE_TOPICS[args.device] + "/value")
+        watch.loop_start()
+
+        self.procs = [subprocess.Popen(pico, pass_fds=[pico_end.fileno()]),
+                      subprocess.Popen(wemos, pass_fds=[wemos_end.fileno()])]
+        pico_end.close()
+        wemos_end.close()
+        ready = up.wait(30)
+        watch.loop_stop()
+        watch.disconnect()
+        if not ready:
+            self.stop()
+            raise SystemExit("host firmware did not reach the broker")
+
+    def stop(self):
+        for proc in self.procs:
+            proc.terminate()
+        for proc in self.procs:
+            proc.wait()
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("--host", default="localhost")
+    p.add_argument("--port", type=int, default=1883)
+    p.add_argument("--tls", action="store_true")
+    p.add_argument("-u", "--username")
+    p.add_argument("-P", "--password")
+    p.add_argument("--device", type=int, default=0, choices=sorted(DEVICE_TOPICS))
+    p.add_argument("--rate", type=float, default=0.5, help="commands per second")
+    p.add_argument("--count", type=int, default=20, help="commands to send")
+    p.add_argument("--values", default="20,60", help="device values to alternate between")
+    p.add_argument("--sensor-cycles", type=int, default=0, help="WS reports to wait for")
+    p.add_argument("--timer-period-ms", type=int, default=0,
+                   help="repeating timer period of the host Pico firmware, 0 keeps the firmware's")
+    p.add_argument("--timeout", type=float, default=30, help="s to wait for reports after the last command")
+    p.add_argument("--gate", action="append", default=[], metavar="METRIC:p99|p50|max:MS",
+                   help="fail if the statistic of the metric exceeds MS, e.g. W0:p99:2000")
+    p.add_argument("--min-acked", type=int, default=0, help="fail if fewer %% of commands are acked")
+    p.add_argument("--host-firmware", metavar="DIR",
+                   help="run the host builds of the firmware in DIR against an in-process broker")
+    args = p.parse_args()
+
+    host, port = args.host, args.port
+    firmware = None
+    if args.host_firmware:
+        broker = StandInBroker()
+        host, port = "127.0.0.1", broker.port
+        firmware = HostFirmware(port, args)
+
+    results = Results()
+    driver = Driver(args, results)
+    try:
+        driver.start(host, port)
+        driver.run()
+    finally:
+        if firmware:
+            firmware.stop()
+    sys.exit(report(args, results))
+
+
+if __name__ == "__main__":
+    main()
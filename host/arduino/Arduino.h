@@ -0,0 +1,108 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/*
+ * The parts of the ESP8266 Arduino core the sketch uses, on a Linux host.
+ * Serial is the UART link to the Pico, on the socket from the host run;
+ * time is the host's clock. See arduino_host.h.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+#include "arduino_host.h"
+#include "uart_link.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define LED_BUILTIN 2
+#define DEC 10
+#define HEX 16
+#define PSTR(s) (s)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void configTime(const char* tz, const char* server1, const char* server2);
+
+class String {
+ public:
+  String(const char* s = "") : s_(s ? s : "") {}
+  String(int value, unsigned char base = DEC) : String((long)value, base) {}
+  String(unsigned int value, unsigned char base = DEC) : String((unsigned long)value, base) {}
+  String(long value, unsigned char base = DEC);
+  String(unsigned long value, unsigned char base = DEC);
+  String& operator+=(const String& other) { s_ += other.s_; return *this; }
+  String& operator+=(const char* other) { s_ += other; return *this; }
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+
+ private:
+  std::string s_;
+};
+
+class IPAddress {
+ public:
+  IPAddress(uint32_t address = 0) : address_(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address_(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+  operator uint32_t() const { return address_; }
+  String toString() const;
+
+ private:
+  uint32_t address_;
+};
+
+/* the UART to the Pico: 128 bytes of tx fifo, and an rx buffer of
+ * setRxBufferSize() bytes, 256 unless set, as on the ESP8266 */
+class HardwareSerial {
+ public:
+  void setRxBufferSize(size_t size) { rx_size_ = size; }
+  void begin(unsigned long baud);
+  int available();
+  int read();
+  size_t write(char c);
+  size_t print(const char* s);
+  size_t print(char c) { return write(c); }
+  size_t print(int value) { return print((long)value); }
+  size_t print(unsigned int value) { return print((unsigned long)value); }
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t print(const IPAddress& ip) { return print(ip.toString()); }
+  template <typename T> size_t println(const T& value) { return print(value) + println(); }
+  size_t println() { return print("\r\n"); }
+  size_t printf(const char* format, ...);
+
+ private:
+  uart_link link_;
+  size_t rx_size_ = 256;
+  bool open_ = false;
+};
+extern HardwareSerial Serial;
+
+/* RTC user memory survives a reset, not a host run */
+class EspClass {
+ public:
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+};
+extern EspClass ESP;
+
+#endif
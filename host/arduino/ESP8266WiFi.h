@@ -0,0 +1,63 @@
+#ifndef ESP8266WIFI_H
+#define ESP8266WIFI_H
+
+/* the host is already on its network: WiFi associates at once. The secure
+ * client is a plain TCP socket, the broker stand-in takes no TLS */
+
+#include "Arduino.h"
+
+#define WIFI_STA 1
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+
+class ESP8266WiFiClass {
+ public:
+  bool mode(int m) { (void)m; return true; }
+  int begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+      const uint8_t* bssid = nullptr, bool connect = true);
+  int status() { return begun_ ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns = IPAddress()) {
+    (void)local_ip; (void)gateway; (void)subnet; (void)dns;
+    return true;
+  }
+  bool disconnect(bool wifioff = false) { (void)wifioff; begun_ = false; return true; }
+  int32_t channel() { return 1; }
+  uint8_t* BSSID() { return bssid_; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress gatewayIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+  IPAddress dnsIP() { return IPAddress(127, 0, 0, 1); }
+
+ private:
+  bool begun_ = false;
+  uint8_t bssid_[6] = {0};
+};
+extern ESP8266WiFiClass WiFi;
+
+class Client {
+ public:
+  virtual ~Client() {}
+  virtual int connect(const char* host, uint16_t port);
+  virtual size_t write(const uint8_t* buf, size_t size);
+  virtual int available();
+  virtual int read();
+  virtual uint8_t connected();
+  virtual void stop();
+
+ private:
+  int fd_ = -1;
+};
+
+namespace BearSSL {
+class CertStore;
+
+class WiFiClientSecure : public Client {
+ public:
+  void setCertStore(CertStore* store) { (void)store; }
+  void setX509Time(time_t now) { (void)now; }
+};
+}  // namespace BearSSL
+
+using WiFiClientSecure = BearSSL::WiFiClientSecure;
+
+#endif
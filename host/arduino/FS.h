@@ -0,0 +1,22 @@
+#ifndef FS_H
+#define FS_H
+
+/* no flash on the host: every file fails to open */
+
+#include "Arduino.h"
+
+class File {
+ public:
+  explicit operator bool() const { return false; }
+  size_t read(uint8_t* buf, size_t size) { (void)buf; (void)size; return 0; }
+  size_t write(const uint8_t* buf, size_t size) { (void)buf; (void)size; return 0; }
+  void close() {}
+};
+
+class FS {
+ public:
+  bool begin() { return true; }
+  File open(const char* path, const char* mode) { (void)path; (void)mode; return File(); }
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef NTPCLIENT_H
+#define NTPCLIENT_H
+
+/* NTP time is the host's clock, with the offset applied */
+
+#include "Arduino.h"
+#include "WiFiUdp.h"
+
+class NTPClient {
+ public:
+  NTPClient(WiFiUDP& udp, const char* pool, long offset) : offset_(offset) { (void)udp; (void)pool; }
+  void begin() {}
+  bool update() { return true; }
+  unsigned long getEpochTime() const { return (unsigned long)(time(nullptr) + offset_); }
+  int getHours() const { return (int)((getEpochTime() % 86400L) / 3600); }
+  String getFormattedTime() const;
+
+ private:
+  long offset_;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PUBSUBCLIENT_H
+#define PUBSUBCLIENT_H
+
+/* MQTT 3.1.1 client with the behaviour of PubSubClient 2.8 the sketch
+ * relies on: QoS 0, a 256-byte packet buffer which a publish must fit,
+ * one received packet handled per loop(), a ping after 15 s idle */
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_MAX_HEADER_SIZE 5
+#define MQTT_KEEPALIVE 15
+#define MQTT_SOCKET_TIMEOUT 15
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+typedef void (*MQTT_CALLBACK_SIGNATURE)(char*, uint8_t*, unsigned int);
+
+class PubSubClient {
+ public:
+  explicit PubSubClient(Client& client) : client_(&client) {}
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE callback);
+  bool connect(const char* id, const char* user, const char* pass);
+  bool connected();
+  bool subscribe(const char* topic);
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained);
+  bool loop();
+  int state() { return state_; }
+
+ private:
+  bool write(uint8_t header, const uint8_t* body, size_t length);
+  bool readByte(uint8_t* b);
+  size_t readPacket();
+
+  Client* client_;
+  const char* domain_ = nullptr;
+  uint16_t port_ = 0;
+  MQTT_CALLBACK_SIGNATURE callback_ = nullptr;
+  uint8_t buffer_[MQTT_MAX_PACKET_SIZE];
+  uint16_t next_msg_id_ = 0;
+  unsigned long last_out_ = 0;
+  unsigned long last_in_ = 0;
+  bool ping_outstanding_ = false;
+  int state_ = MQTT_DISCONNECTED;
+};
+
+#endif
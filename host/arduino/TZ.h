@@ -0,0 +1,6 @@
+#ifndef TZ_H
+#define TZ_H
+
+#define TZ_Europe_Berlin PSTR("CET-1CEST,M3.5.0,M10.5.0/3")
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef TIMELIB_H
+#define TIMELIB_H
+
+#include <time.h>
+
+int day(time_t t);
+int month(time_t t);
+int year(time_t t);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+class WiFiUDP {};
+
+#endif
@@ -0,0 +1,496 @@
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include "LittleFS.h"
+#include "NTPClient.h"
+#include "PubSubClient.h"
+#include "TimeLib.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+arduino_host_config arduino_host = {-1, nullptr, 0};
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+FS LittleFS;
+
+/*** time ***/
+static uint64_t host_us() {
+  static timespec boot;
+  timespec ts;
+  if (boot.tv_sec == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &boot);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)(ts.tv_sec - boot.tv_sec) * 1000000 + (ts.tv_nsec - boot.tv_nsec) / 1000;
+}
+
+unsigned long millis() {
+  return (unsigned long)(host_us() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)host_us();
+}
+
+void delay(unsigned long ms) {
+  timespec ts = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000};
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+  }
+}
+
+void yield() {
+}
+
+long random(long howbig) {
+  return howbig > 0 ? rand() % howbig : 0;
+}
+
+long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  srand((unsigned)seed);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  (void)pin;
+  (void)val;
+}
+
+void configTime(const char* tz, const char* server1, const char* server2) {
+  (void)tz;
+  (void)server1;
+  (void)server2;
+}
+
+int day(time_t t) {
+  tm parts;
+  gmtime_r(&t, &parts);
+  return parts.tm_mday;
+}
+
+int month(time_t t) {
+  tm parts;
+  gmtime_r(&t, &parts);
+  return parts.tm_mon + 1;
+}
+
+int year(time_t t) {
+  tm parts;
+  gmtime_r(&t, &parts);
+  return parts.tm_year + 1900;
+}
+
+String NTPClient::getFormattedTime() const {
+  char hms[9];
+  unsigned long t = getEpochTime();
+  snprintf(hms, sizeof(hms), "%02lu:%02lu:%02lu", (t % 86400L) / 3600, (t % 3600) / 60, t % 60);
+  return String(hms);
+}
+
+/*** strings ***/
+String::String(long value, unsigned char base) {
+  char buf[40];
+  if (base == HEX) {
+    snprintf(buf, sizeof(buf), "%lx", (unsigned long)value);
+  } else {
+    snprintf(buf, sizeof(buf), "%ld", value);
+  }
+  s_ = buf;
+}
+
+String::String(unsigned long value, unsigned char base) {
+  char buf[40];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%lu", value);
+  s_ = buf;
+}
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", address_ & 0xFF, (address_ >> 8) & 0xFF,
+    (address_ >> 16) & 0xFF, address_ >> 24);
+  return String(buf);
+}
+
+/*** serial: the UART link to the Pico ***/
+#define SERIAL_TX_FIFO 128
+
+void HardwareSerial::begin(unsigned long baud) {
+  uart_link_open(&link_, "wemos", arduino_host.uart_fd, (uint32_t)baud, SERIAL_TX_FIFO, (unsigned)rx_size_);
+  open_ = true;
+}
+
+int HardwareSerial::available() {
+  return open_ ? (int)uart_link_available(&link_, 0) : 0;
+}
+
+int HardwareSerial::read() {
+  return available() > 0 ? uart_link_getc(&link_) : -1;
+}
+
+size_t HardwareSerial::write(char c) {
+  if (open_) {
+    uart_link_putc(&link_, c);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::print(const char* s) {
+  size_t n = 0;
+  for (; *s; s++) {
+    n += write(*s);
+  }
+  return n;
+}
+
+size_t HardwareSerial::print(long value) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", value);
+  return print(buf);
+}
+
+size_t HardwareSerial::print(unsigned long value) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", value);
+  return print(buf);
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  return print(buf);
+}
+
+/*** RTC user memory: 512 bytes in 4-byte blocks ***/
+static uint32_t rtc_memory[128];
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size) {
+  if (offset * 4 + size > sizeof(rtc_memory)) {
+    return false;
+  }
+  memcpy(data, (uint8_t*)rtc_memory + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size) {
+  if (offset * 4 + size > sizeof(rtc_memory)) {
+    return false;
+  }
+  memcpy((uint8_t*)rtc_memory + offset * 4, data, size);
+  return true;
+}
+
+/*** network ***/
+int ESP8266WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel,
+    const uint8_t* bssid, bool connect) {
+  (void)ssid;
+  (void)passphrase;
+  (void)channel;
+  (void)bssid;
+  begun_ = connect;
+  return status();
+}
+
+int Client::connect(const char* host, uint16_t port) {
+  addrinfo hints = {};
+  addrinfo* found = nullptr;
+  char service[8];
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(host, service, &hints, &found) != 0) {
+    return 0;
+  }
+  stop();
+  for (addrinfo* a = found; a && fd_ < 0; a = a->ai_next) {
+    fd_ = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd_ >= 0 && ::connect(fd_, a->ai_addr, a->ai_addrlen) != 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+  freeaddrinfo(found);
+  return fd_ >= 0;
+}
+
+size_t Client::write(const uint8_t* buf, size_t size) {
+  size_t sent = 0;
+  while (fd_ >= 0 && sent < size) {
+    ssize_t n = send(fd_, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      stop();
+      break;
+    }
+    sent += (size_t)n;
+  }
+  return sent;
+}
+
+int Client::available() {
+  int n = 0;
+  if (fd_ < 0 || ioctl(fd_, FIONREAD, &n) != 0) {
+    return 0;
+  }
+  return n;
+}
+
+int Client::read() {
+  uint8_t b;
+  if (available() <= 0 || recv(fd_, &b, 1, 0) != 1) {
+    return -1;
+  }
+  return b;
+}
+
+uint8_t Client::connected() {
+  uint8_t b;
+  if (fd_ < 0) {
+    return 0;
+  }
+  ssize_t n = recv(fd_, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+void Client::stop() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+/*** MQTT ***/
+#define MQTTCONNECT (1 << 4)
+#define MQTTCONNACK (2 << 4)
+#define MQTTPUBLISH (3 << 4)
+#define MQTTSUBSCRIBE (8 << 4)
+#define MQTTPINGREQ (12 << 4)
+#define MQTTPINGRESP (13 << 4)
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  domain_ = domain;
+  port_ = port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE callback) {
+  callback_ = callback;
+  return *this;
+}
+
+/* fixed header, remaining length and body, in one write as the library does */
+bool PubSubClient::write(uint8_t header, const uint8_t* body, size_t length) {
+  uint8_t packet[MQTT_MAX_PACKET_SIZE + MQTT_MAX_HEADER_SIZE];
+  size_t n = 0;
+  size_t len = length;
+  packet[n++] = header;
+  do {
+    uint8_t digit = len % 128;
+    len /= 128;
+    packet[n++] = digit | (len > 0 ? 0x80 : 0);
+  } while (len > 0);
+  memcpy(packet + n, body, length);
+  n += length;
+  last_out_ = millis();
+  return client_->write(packet, n) == n;
+}
+
+bool PubSubClient::readByte(uint8_t* b) {
+  unsigned long start = millis();
+  while (!client_->available()) {
+    if (millis() - start >= MQTT_SOCKET_TIMEOUT * 1000UL || !client_->connected()) {
+      return false;
+    }
+    delay(1);
+  }
+  *b = (uint8_t)client_->read();
+  return true;
+}
+
+/* one packet into buffer_, fixed header included; its length, 0 on a
+ * timeout. A packet which does not fit is read and dropped */
+size_t PubSubClient::readPacket() {
+  uint8_t b;
+  uint32_t length = 0;
+  uint32_t multiplier = 1;
+  size_t n = 0;
+  if (!readByte(&b)) {
+    return 0;
+  }
+  buffer_[n++] = b;
+  do {
+    if (!readByte(&b)) {
+      return 0;
+    }
+    buffer_[n++] = b;
+    length += (b & 0x7F) * multiplier;
+    multiplier *= 128;
+  } while ((b & 0x80) && n < MQTT_MAX_HEADER_SIZE);
+
+  size_t body = n;
+  for (uint32_t i = 0; i < length; i++) {
+    if (!readByte(&b)) {
+      return 0;
+    }
+    if (body + i < MQTT_MAX_PACKET_SIZE) {
+      buffer_[body + i] = b;
+    }
+  }
+  return body + length <= MQTT_MAX_PACKET_SIZE ? body + length : 0;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  uint8_t body[MQTT_MAX_PACKET_SIZE];
+  size_t n = 0;
+  const char* host = arduino_host.broker_host ? arduino_host.broker_host : domain_;
+  uint16_t port = arduino_host.broker_host ? arduino_host.broker_port : port_;
+  if (!client_->connect(host, port)) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+
+  auto put_string = [&](const char* s) {
+    size_t len = strlen(s);
+    body[n++] = (uint8_t)(len >> 8);
+    body[n++] = (uint8_t)len;
+    memcpy(body + n, s, len);
+    n += len;
+  };
+  put_string("MQTT");
+  body[n++] = 4; // 3.1.1
+  body[n++] = 0x02 | (user ? 0x80 : 0) | (user && pass ? 0x40 : 0); // clean session
+  body[n++] = 0;
+  body[n++] = MQTT_KEEPALIVE;
+  put_string(id);
+  if (user) {
+    put_string(user);
+    if (pass) {
+      put_string(pass);
+    }
+  }
+  write(MQTTCONNECT, body, n);
+
+  size_t len = readPacket();
+  if (len == 4 && buffer_[0] == MQTTCONNACK && buffer_[3] == 0) {
+    last_in_ = millis();
+    ping_outstanding_ = false;
+    state_ = MQTT_CONNECTED;
+    return true;
+  }
+  state_ = len ? buffer_[3] : MQTT_CONNECTION_TIMEOUT;
+  client_->stop();
+  return false;
+}
+
+bool PubSubClient::connected() {
+  if (state_ != MQTT_CONNECTED) {
+    return false;
+  }
+  if (!client_->connected()) {
+    state_ = MQTT_CONNECTION_LOST;
+    return false;
+  }
+  return true;
+}
+
+bool PubSubClient::subscribe(const char* topic) {
+  uint8_t body[MQTT_MAX_PACKET_SIZE];
+  size_t len = strlen(topic);
+  if (MQTT_MAX_PACKET_SIZE < 9 + len || !connected()) {
+    return false;
+  }
+  next_msg_id_ = next_msg_id_ + 1 ? next_msg_id_ + 1 : 1;
+  body[0] = (uint8_t)(next_msg_id_ >> 8);
+  body[1] = (uint8_t)next_msg_id_;
+  body[2] = (uint8_t)(len >> 8);
+  body[3] = (uint8_t)len;
+  memcpy(body + 4, topic, len);
+  body[4 + len] = 0; // QoS 0
+  return write(MQTTSUBSCRIBE | 0x02, body, len + 5);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, (unsigned int)strlen(payload), false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, (unsigned int)strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+  return publish(topic, payload, plength, false);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained) {
+  uint8_t body[MQTT_MAX_PACKET_SIZE];
+  size_t len = strlen(topic);
+  if (!connected() || MQTT_MAX_PACKET_SIZE < MQTT_MAX_HEADER_SIZE + 2 + len + plength) {
+    return false;
+  }
+  body[0] = (uint8_t)(len >> 8);
+  body[1] = (uint8_t)len;
+  memcpy(body + 2, topic, len);
+  memcpy(body + 2 + len, payload, plength);
+  return write(MQTTPUBLISH | (retained ? 1 : 0), body, 2 + len + plength);
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) {
+    return false;
+  }
+  unsigned long t = millis();
+  if (t - last_in_ > MQTT_KEEPALIVE * 1000UL || t - last_out_ > MQTT_KEEPALIVE * 1000UL) {
+    if (ping_outstanding_) {
+      state_ = MQTT_CONNECTION_TIMEOUT;
+      client_->stop();
+      return false;
+    }
+    write(MQTTPINGREQ, nullptr, 0);
+    last_in_ = t;
+    ping_outstanding_ = true;
+  }
+
+  if (client_->available()) {
+    size_t len = readPacket();
+    if (len > 0) {
+      last_in_ = t;
+      uint8_t type = buffer_[0] & 0xF0;
+      if (type == MQTTPUBLISH && callback_) {
+        size_t header = 1;
+        while (buffer_[header++] & 0x80) {
+        }
+        size_t topic_len = (buffer_[header] << 8) | buffer_[header + 1];
+        // the topic is terminated in place, over its length field
+        memmove(buffer_ + header, buffer_ + header + 2, topic_len);
+        buffer_[header + topic_len] = 0;
+        size_t payload = header + 2 + topic_len;
+        if ((buffer_[0] & 0x06) != 0) {
+          payload += 2; // message id of QoS 1 and 2
+        }
+        callback_((char*)buffer_ + header, buffer_ + payload, (unsigned int)(len - payload));
+      } else if (type == MQTTPINGREQ) {
+        write(MQTTPINGRESP, nullptr, 0);
+      } else if (type == MQTTPINGRESP) {
+        ping_outstanding_ = false;
+      }
+    }
+  }
+  return true;
+}
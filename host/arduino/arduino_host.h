@@ -0,0 +1,14 @@
+#ifndef ARDUINO_HOST_H
+#define ARDUINO_HOST_H
+
+#include <stdint.h>
+
+/* host run configuration, set before the sketch's setup() */
+struct arduino_host_config {
+  int uart_fd; // link to the Pico
+  const char* broker_host; // replaces the server of broker.h
+  uint16_t broker_port;
+};
+extern arduino_host_config arduino_host;
+
+#endif
@@ -0,0 +1,5 @@
+/* host build: the broker is given to the host run, see arduino_host.h */
+const char* mqtt_server = "127.0.0.1";
+const int mqtt_port_tls = 1883;
+const char* mqtt_username = "";
+const char* mqtt_password = "";
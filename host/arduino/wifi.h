@@ -0,0 +1,3 @@
+/* host build: no access point to join */
+const char* ssid = "host";
+const char* password = "";
@@ -0,0 +1,304 @@
+/*
+ * Fast start and the Pico line queue of the Wemos sketch, on the host. The
+ * sketch's fastboot.h and mcu_lines.h are included as they are; WiFi, the
+ * clock, the broker and the cache storage are stubs driven by each test.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#define MSG_BUFFER_SIZE (1024) // as in format.h
+#include "fastboot.h"
+#include "mcu_lines.h"
+
+static int failures = 0;
+#define CHECK(cond) do { if (!(cond)) { \
+  printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+// stubbed network, clock, broker and storage
+struct published {
+  std::string topic;
+  std::string payload;
+  bool retained;
+};
+
+static unsigned long stub_ms;
+static time_t stub_now;
+static bool stub_connected;
+static bool stub_mqtt_ok;
+static bool stub_publish_ok;
+static std::vector<bool> begins; // cached or not, per wifi_begin
+static int rescans;
+static int joins;
+static std::vector<time_t> cert_times; // per MQTT attempt
+static std::vector<published> publishes;
+static int rtc_writes;
+static int flash_writes;
+
+static unsigned long stubMillis() { return stub_ms; }
+static time_t stubNow() { return stub_now; }
+static void stubWiFiBegin(bool cached) { begins.push_back(cached); }
+static void stubWiFiRescan() { rescans++; }
+static bool stubWiFiConnected() { return stub_connected; }
+static void stubWiFiJoined() { joins++; }
+
+static bool stubMQTTConnect(time_t cert_time) {
+  cert_times.push_back(cert_time);
+  return stub_mqtt_ok;
+}
+
+static bool stubMQTTPublish(const char* topic, const char* payload, bool retained) {
+  publishes.push_back({topic, payload, retained});
+  return stub_publish_ok;
+}
+
+static void stubStoreCache(boot_cache* cache, bool to_flash) {
+  bootCacheSeal(cache);
+  rtc_writes++;
+  if (to_flash) {
+    flash_writes++;
+  }
+}
+
+static const fast_start_io io = {
+  stubMillis, stubNow, stubWiFiBegin, stubWiFiRescan, stubWiFiConnected,
+  stubWiFiJoined, stubMQTTConnect, stubMQTTPublish, stubStoreCache
+};
+
+static const time_t CACHED_TIME = 1790000000; // last NTP time held in the cache
+
+/* a reset: no network yet, and either a valid cache or none */
+static void boot(bool cached) {
+  memset(&bootCache, 0, sizeof(bootCache));
+  if (cached) {
+    bootCache.channel = 6;
+    bootCache.last_time = CACHED_TIME;
+    bootCacheSeal(&bootCache);
+  }
+  bootCacheLoaded = cached && bootCacheValid(&bootCache);
+  fastAssociation = false;
+  bootReported = false;
+  wifiStartMs = 0;
+  lastMQTTAttemptMs = 0;
+  lastTimeFlashed = 0;
+  memset(boot_ms, 0, sizeof(boot_ms));
+
+  stub_ms = 40;
+  stub_now = 0;
+  stub_connected = false;
+  stub_mqtt_ok = true;
+  stub_publish_ok = true;
+  begins.clear();
+  rescans = 0;
+  joins = 0;
+  cert_times.clear();
+  publishes.clear();
+  rtc_writes = 0;
+  flash_writes = 0;
+
+  startWiFi(&io);
+}
+
+/* cached AP answers: milestones in order, one retained B1 report */
+static void testCachedBootReport() {
+  boot(true);
+  CHECK(begins.size() == 1 && begins[0]);
+
+  stub_ms = 120;
+  connectStep(&io);
+  CHECK(boot_ms[BOOT_WIFI] == 0 && cert_times.empty());
+
+  stub_ms = 300;
+  stub_connected = true;
+  connectStep(&io);
+  CHECK(boot_ms[BOOT_WIFI] == 300 && joins == 1);
+  CHECK(cert_times.size() == 1 && cert_times[0] == CACHED_TIME); // NTP not done yet
+  CHECK(boot_ms[BOOT_MQTT] == 300);
+
+  stub_ms = 350;
+  bootMilestone(BOOT_FIRST_PUBLISH, &io);
+  reportBoot("wifi/status", &io);
+  CHECK(publishes.empty()); // waits for NTP
+
+  stub_ms = 900;
+  stub_now = CACHED_TIME + 600;
+  timeStep(&io);
+  CHECK(boot_ms[BOOT_NTP] == 900);
+  CHECK(bootCache.last_time == (uint32_t)stub_now && flash_writes == 1);
+
+  stub_ms = 1000;
+  bootMilestone(BOOT_FIRST_PUBLISH, &io); // later publishes keep the first
+  reportBoot("wifi/status", &io);
+  reportBoot("wifi/status", &io);
+  CHECK(publishes.size() == 1);
+  CHECK(publishes[0].topic == "wifi/status");
+  CHECK(publishes[0].payload == "B1=300,300,900,350;");
+  CHECK(publishes[0].retained);
+}
+
+/* no cache: a plain scan, B0 */
+static void testUncachedBootReport() {
+  boot(false);
+  CHECK(begins.size() == 1 && !begins[0]);
+
+  stub_ms = 2500;
+  stub_connected = true;
+  stub_now = CACHED_TIME;
+  connectStep(&io);
+  timeStep(&io);
+  bootMilestone(BOOT_FIRST_PUBLISH, &io);
+  reportBoot("wifi/status", &io);
+  CHECK(publishes.size() == 1 && publishes[0].payload == "B0=2500,2500,2500,2500;");
+}
+
+/* cached AP gone: given up after FAST_START_TIMEOUT_MS for one full scan */
+static void testCachedTimeout() {
+  boot(true);
+  stub_ms = 40 + FAST_START_TIMEOUT_MS;
+  connectStep(&io);
+  CHECK(rescans == 0 && fastAssociation);
+
+  stub_ms = 41 + FAST_START_TIMEOUT_MS;
+  connectStep(&io);
+  connectStep(&io);
+  CHECK(rescans == 1 && !fastAssociation);
+}
+
+/* broker attempts spaced by MQTT_RETRY_MS; the live time is used once NTP is done */
+static void testMQTTRetry() {
+  boot(true);
+  stub_connected = true;
+  stub_mqtt_ok = false;
+
+  stub_ms = 1000;
+  connectStep(&io);
+  stub_ms = 1000 + MQTT_RETRY_MS - 1;
+  connectStep(&io);
+  CHECK(cert_times.size() == 1);
+
+  stub_ms = 1000 + MQTT_RETRY_MS;
+  stub_now = CACHED_TIME + 3600;
+  connectStep(&io);
+  CHECK(cert_times.size() == 2 && cert_times[1] == stub_now);
+  CHECK(boot_ms[BOOT_MQTT] == 0 && joins == 1);
+
+  stub_ms += MQTT_RETRY_MS;
+  stub_mqtt_ok = true;
+  connectStep(&io);
+  CHECK(boot_ms[BOOT_MQTT] == stub_ms);
+}
+
+/* a report the broker did not take is sent again */
+static void testReportRetried() {
+  boot(true);
+  stub_connected = true;
+  stub_now = CACHED_TIME;
+  connectStep(&io);
+  timeStep(&io);
+  bootMilestone(BOOT_FIRST_PUBLISH, &io);
+
+  stub_publish_ok = false;
+  reportBoot("wifi/status", &io);
+  stub_publish_ok = true;
+  reportBoot("wifi/status", &io);
+  reportBoot("wifi/status", &io);
+  CHECK(publishes.size() == 2 && bootReported);
+}
+
+/* the cached time: RTC memory hourly, flash weekly */
+static void testTimeRefresh() {
+  boot(true);
+  stub_now = CACHED_TIME;
+  timeStep(&io);
+  CHECK(rtc_writes == 1 && flash_writes == 1);
+
+  stub_now = CACHED_TIME + BOOT_TIME_RTC_PERIOD_S - 1;
+  timeStep(&io);
+  CHECK(rtc_writes == 1);
+
+  stub_now = CACHED_TIME + BOOT_TIME_RTC_PERIOD_S;
+  timeStep(&io);
+  CHECK(rtc_writes == 2 && flash_writes == 1);
+  CHECK(bootCache.last_time == (uint32_t)stub_now && bootCacheValid(&bootCache));
+
+  for (time_t t = CACHED_TIME; t <= CACHED_TIME + BOOT_TIME_FLASH_PERIOD_S; t += 60) {
+    stub_now = t;
+    timeStep(&io);
+  }
+  CHECK(rtc_writes == 1 + BOOT_TIME_FLASH_PERIOD_S / BOOT_TIME_RTC_PERIOD_S);
+  CHECK(flash_writes == 2);
+}
+
+/* held lines come out in order; when full the oldest go, and long ones are cut */
+static void testQueue() {
+  char line[MSG_BUFFER_SIZE];
+  pending_head = 0;
+  pending_count = 0;
+  CHECK(!dequeueFromMCU(line));
+
+  for (int i = 0; i < PENDING_LINES + 3; i++) {
+    sprintf(line, "S%d=%d;\n", i % 3, i);
+    queueFromMCU(line);
+  }
+  CHECK(pending_count == PENDING_LINES);
+  for (int i = 3; i < PENDING_LINES + 3; i++) {
+    char expected[32];
+    sprintf(expected, "S%d=%d;\n", i % 3, i);
+    CHECK(dequeueFromMCU(line) && strcmp(line, expected) == 0);
+  }
+  CHECK(!dequeueFromMCU(line));
+
+  std::string longLine(200, 'x');
+  queueFromMCU(longLine.c_str());
+  CHECK(dequeueFromMCU(line) && strlen(line) == PENDING_LINE_SIZE - 1);
+}
+
+/* lines split across reads are handed on whole; an overlong one is dropped */
+static void testLineAssembly() {
+  char line[MSG_BUFFER_SIZE];
+  mcu_line_len = 0;
+  mcu_line_overlong = false;
+
+  const char* fragments[] = {"S0=4", "5.5;\nD1", "=12;", "\n"};
+  std::vector<std::string> lines;
+  for (const char* f : fragments) {
+    for (; *f; f++) {
+      if (mcuLineFeed(*f, line)) {
+        lines.push_back(line);
+      }
+    }
+  }
+  CHECK(lines.size() == 2 && lines[0] == "S0=45.5;\n" && lines[1] == "D1=12;\n");
+
+  int complete = 0;
+  for (int i = 0; i < MSG_BUFFER_SIZE + 10; i++) {
+    complete += mcuLineFeed('x', line);
+  }
+  complete += mcuLineFeed('\n', line);
+  CHECK(complete == 0);
+
+  for (const char* c = "M0=1;\n"; *c; c++) {
+    complete += mcuLineFeed(*c, line);
+  }
+  CHECK(complete == 1 && strcmp(line, "M0=1;\n") == 0);
+}
+
+int main() {
+  testCachedBootReport();
+  testUncachedBootReport();
+  testCachedTimeout();
+  testMQTTRetry();
+  testReportRetried();
+  testTimeRefresh();
+  testQueue();
+  testLineAssembly();
+
+  if (failures == 0) {
+    printf("fast start: all checks passed\n");
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,2 @@
+/* host build: the simulated SDK, see pico_hal.h */
+#include "pico_hal.h"
@@ -0,0 +1,718 @@
+#define _GNU_SOURCE
+#include "pico_hal.h"
+#include "uart_link.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HAL_IRQ_SIGNAL SIGUSR1
+#define HAL_SYS_CLOCK_MHZ 125
+#define HAL_UART_FIFO 32 // rx and tx fifo depth of the RP2040 UART
+#define HAL_MULTICORE_FIFO 8
+#define HAL_SPIN_LOCKS 32
+#define HAL_DHT_PIN 22 // DHT_PIN in sensors.h
+#define HAL_CORE0_POLL_US 100 // an idle uart poll on core0 waits this long for a byte
+
+hal_config hal = {-1, 0, 45.0f, 21.5f, 30.0f};
+uart_inst_t hal_uart0 = {0};
+spi_inst_t hal_spi0 = {0, {0}};
+dma_hw_t hal_dma_hw;
+
+static struct timespec boot;
+static pthread_t core_thread[2];
+static __thread int hal_core = 0; // core of the calling thread
+
+/*** time ***/
+uint64_t time_us_64(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)(ts.tv_sec - boot.tv_sec) * 1000000 + (ts.tv_nsec - boot.tv_nsec) / 1000;
+}
+
+uint32_t time_us_32(void) {
+	return (uint32_t)time_us_64();
+}
+
+absolute_time_t get_absolute_time(void) {
+	return time_us_64();
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t) {
+	return (uint32_t)(t / 1000);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms) {
+	return time_us_64() + (uint64_t)ms * 1000;
+}
+
+bool time_reached(absolute_time_t t) {
+	return time_us_64() >= t;
+}
+
+/* sleep to an absolute time, through any irq signals taken meanwhile */
+static void hal_sleep_until(uint64_t t_us) {
+	uint64_t ns = (uint64_t)boot.tv_nsec + (t_us % 1000000) * 1000;
+	struct timespec ts = {boot.tv_sec + (time_t)(t_us / 1000000) + (time_t)(ns / 1000000000),
+		(long)(ns % 1000000000)};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+void sleep_ms(uint32_t ms) {
+	hal_sleep_until(time_us_64() + (uint64_t)ms * 1000);
+}
+
+void stdio_init_all(void) {
+}
+
+/*** irqs: a signal to the core which enabled the irq ***/
+static irq_handler_t irq_handlers[HAL_IRQ_COUNT];
+static int irq_core[HAL_IRQ_COUNT]; // -1 while disabled
+static atomic_uint irq_pending[2];
+
+static void hal_irq_raise(uint num) {
+	int core = irq_core[num];
+	if (core < 0) {
+		return;
+	}
+	atomic_fetch_or(&irq_pending[core], 1u << num);
+	pthread_kill(core_thread[core], HAL_IRQ_SIGNAL);
+}
+
+/* the core's irq handlers, with its irqs masked as on the chip */
+static void hal_irq_signal(int sig) {
+	(void)sig;
+	int saved_errno = errno;
+	uint32_t pending;
+	while ((pending = atomic_exchange(&irq_pending[hal_core], 0)) != 0) {
+		for (uint n = 0; n < HAL_IRQ_COUNT; n++) {
+			if ((pending & (1u << n)) && irq_handlers[n]) {
+				irq_handlers[n]();
+			}
+		}
+	}
+	errno = saved_errno;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+	irq_handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+	irq_core[num] = enabled ? hal_core : -1;
+}
+
+static void hal_mask_irqs(bool mask, sigset_t *old) {
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, HAL_IRQ_SIGNAL);
+	pthread_sigmask(mask ? SIG_BLOCK : SIG_UNBLOCK, &set, old);
+}
+
+/* peripheral registers: one lock, taken with the caller's irqs masked so
+ * a handler on the same core never waits for it */
+static atomic_flag hal_regs = ATOMIC_FLAG_INIT;
+
+static sigset_t hal_lock(void) {
+	sigset_t old;
+	hal_mask_irqs(true, &old);
+	while (atomic_flag_test_and_set(&hal_regs)) {
+		sched_yield();
+	}
+	return old;
+}
+
+static void hal_unlock(sigset_t old) {
+	atomic_flag_clear(&hal_regs);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/*** sync ***/
+static spin_lock_t spin_locks[HAL_SPIN_LOCKS];
+static atomic_uint spin_locks_claimed;
+
+uint spin_lock_claim_unused(bool required) {
+	uint num = atomic_fetch_add(&spin_locks_claimed, 1);
+	if (num >= HAL_SPIN_LOCKS && required) {
+		fprintf(stderr, "no spin locks left\n");
+		abort();
+	}
+	return num;
+}
+
+spin_lock_t *spin_lock_init(uint lock_num) {
+	spin_locks[lock_num] = 0;
+	return &spin_locks[lock_num];
+}
+
+/* irqs masked on this core, then the lock taken; returns whether they were masked */
+uint32_t spin_lock_blocking(spin_lock_t *lock) {
+	sigset_t old;
+	hal_mask_irqs(true, &old);
+	while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+	return sigismember(&old, HAL_IRQ_SIGNAL);
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+	if (!saved_irq) {
+		hal_mask_irqs(false, NULL);
+	}
+}
+
+void __dmb(void) {
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*** multicore: fifos towards each core, and core1's thread ***/
+static struct {
+	atomic_uint head, count;
+	uint32_t data[HAL_MULTICORE_FIFO];
+} fifo[2]; // indexed by the receiving core
+
+bool multicore_fifo_rvalid(void) {
+	return atomic_load(&fifo[hal_core].count) > 0;
+}
+
+bool multicore_fifo_wready(void) {
+	return atomic_load(&fifo[!hal_core].count) < HAL_MULTICORE_FIFO;
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+	int to = !hal_core;
+	while (!multicore_fifo_wready()) {
+		sched_yield();
+	}
+	fifo[to].data[(atomic_load(&fifo[to].head) + atomic_load(&fifo[to].count)) % HAL_MULTICORE_FIFO] = data;
+	atomic_fetch_add(&fifo[to].count, 1);
+	hal_irq_raise(to ? SIO_IRQ_PROC1 : SIO_IRQ_PROC0);
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+	while (!multicore_fifo_rvalid()) {
+		sched_yield();
+	}
+	uint head = atomic_load(&fifo[hal_core].head);
+	uint32_t data = fifo[hal_core].data[head];
+	atomic_store(&fifo[hal_core].head, (head + 1) % HAL_MULTICORE_FIFO);
+	atomic_fetch_sub(&fifo[hal_core].count, 1);
+	return data;
+}
+
+void multicore_fifo_clear_irq(void) {
+}
+
+static void *core1_thread(void *entry) {
+	hal_core = 1;
+	// core1's idle loop spins: every other thread preempts it as soon as it wakes
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+	hal_mask_irqs(false, NULL);
+	((void (*)(void))entry)();
+	return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+	pthread_create(&core_thread[1], NULL, core1_thread, (void *)entry);
+}
+
+/*** repeating timer: its alarm irq is taken on the core which added it ***/
+static struct repeating_timer *hal_timer;
+
+static void hal_timer_irq(void) {
+	hal_timer->callback(hal_timer);
+}
+
+static void *hal_timer_thread(void *arg) {
+	(void)arg;
+	uint64_t next = time_us_64();
+	while (1) {
+		next += (uint64_t)hal_timer->delay_us;
+		hal_sleep_until(next);
+		hal_irq_raise(TIMER_IRQ_0);
+	}
+	return NULL;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback,
+		void *user_data, struct repeating_timer *out) {
+	pthread_t thread;
+	uint32_t period_ms = hal.timer_period_ms ? hal.timer_period_ms : (uint32_t)abs(delay_ms);
+	out->delay_us = (int64_t)period_ms * 1000;
+	out->callback = callback;
+	out->user_data = user_data;
+	hal_timer = out;
+	irq_set_exclusive_handler(TIMER_IRQ_0, hal_timer_irq);
+	irq_set_enabled(TIMER_IRQ_0, true);
+	pthread_create(&thread, NULL, hal_timer_thread, NULL);
+	return true;
+}
+
+/*** gpio, and the DHT22 answering a start signal ***/
+#define DHT_BITS 40
+static bool gpio_out[32];
+static bool gpio_level[32];
+static struct {
+	bool responding;
+	bool settled; // the real time of the reply has been slept
+	uint64_t virtual_us; // time since the start signal, in sleep_us steps
+	uint8_t data[5];
+} dht;
+
+/* level of the DHT line t us after the host released it: 30 us pulled up,
+ * 80 low, 80 high, then per bit 50 low and 27 (0) or 70 (1) high, 50 low */
+static bool dht_level(uint64_t t) {
+	uint64_t edge = 30;
+	if (t < edge) return 1;
+	if (t < (edge += 80)) return 0;
+	if (t < (edge += 80)) return 1;
+	for (int bit = 0; bit < DHT_BITS; bit++) {
+		if (t < (edge += 50)) return 0;
+		if (t < (edge += (dht.data[bit / 8] & (0x80 >> (bit % 8))) ? 70 : 27)) return 1;
+	}
+	if (t < (edge += 50)) return 0;
+	return 1;
+}
+
+static void dht_start(void) {
+	uint16_t h = (uint16_t)(hal.humidity * 10 + 0.5f);
+	float t = hal.temp_celsius < 0 ? -hal.temp_celsius : hal.temp_celsius;
+	uint16_t tc = (uint16_t)(t * 10 + 0.5f) | (hal.temp_celsius < 0 ? 0x8000 : 0);
+	dht.data[0] = h >> 8;
+	dht.data[1] = h & 0xFF;
+	dht.data[2] = tc >> 8;
+	dht.data[3] = tc & 0xFF;
+	dht.data[4] = (dht.data[0] + dht.data[1] + dht.data[2] + dht.data[3]) & 0xFF;
+	dht.virtual_us = 0;
+	dht.settled = false;
+	dht.responding = true;
+}
+
+void gpio_init(uint gpio) {
+	gpio_out[gpio] = false;
+	gpio_level[gpio] = false;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+	(void)gpio;
+	(void)fn;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+	if (gpio == HAL_DHT_PIN && !out && gpio_out[gpio] && !gpio_level[gpio]) {
+		dht_start(); // released after the start signal
+	} else if (gpio == HAL_DHT_PIN) {
+		dht.responding = false;
+	}
+	gpio_out[gpio] = out;
+}
+
+void gpio_put(uint gpio, bool value) {
+	gpio_level[gpio] = value;
+}
+
+bool gpio_get(uint gpio) {
+	if (gpio == HAL_DHT_PIN && !gpio_out[gpio]) {
+		return dht.responding ? dht_level(dht.virtual_us) : 1;
+	}
+	return gpio_level[gpio];
+}
+
+/* while the DHT replies, sleep_us steps its waveform instead of the host
+ * clock, whose sleeps are far coarser than 1 us; the reply's real duration
+ * is slept once it is over */
+void sleep_us(uint64_t us) {
+	if (!dht.responding) {
+		hal_sleep_until(time_us_64() + us);
+		return;
+	}
+	dht.virtual_us += us;
+	if (!dht.settled && dht.virtual_us >= 30 + 80 + 80 + DHT_BITS * (50 + 70) + 50) {
+		dht.settled = true;
+		sleep_ms((uint32_t)(dht.virtual_us / 1000));
+	}
+}
+
+/*** uart ***/
+static uart_link hal_uart_link;
+
+uint uart_init(uart_inst_t *uart, uint baudrate) {
+	(void)uart;
+	uart_link_open(&hal_uart_link, "pico", hal.uart_fd, baudrate, HAL_UART_FIFO, HAL_UART_FIFO);
+	return baudrate;
+}
+
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity) {
+	(void)uart;
+	(void)data_bits;
+	(void)stop_bits;
+	(void)parity;
+}
+
+/* core0 polls this in its main loop; an empty poll waits briefly for a byte
+ * rather than spin, so the simulation leaves the host cpu to the other threads */
+bool uart_is_readable(uart_inst_t *uart) {
+	(void)uart;
+	return uart_link_available(&hal_uart_link, HAL_CORE0_POLL_US) > 0;
+}
+
+char uart_getc(uart_inst_t *uart) {
+	(void)uart;
+	return (char)uart_link_getc(&hal_uart_link);
+}
+
+void uart_puts(uart_inst_t *uart, const char *s) {
+	(void)uart;
+	for (; *s; s++) {
+		uart_link_putc(&hal_uart_link, *s);
+	}
+}
+
+/*** spi: frames written are kept as the last write to the digipot chain ***/
+static uint16_t spi_frames[8];
+static size_t spi_frame_count;
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+	(void)spi;
+	return baudrate;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+	(void)spi;
+	(void)data_bits;
+	(void)cpol;
+	(void)cpha;
+	(void)order;
+}
+
+static void spi_frame(uint16_t frame) {
+	spi_frames[spi_frame_count++ % 8] = frame;
+}
+
+int spi_write16_blocking(spi_inst_t *spi, const uint16_t *src, size_t len) {
+	(void)spi;
+	for (size_t i = 0; i < len; i++) {
+		spi_frame(src[i]);
+	}
+	hal_sleep_until(time_us_64() + len * 2); // 16 bits at 10 MHz, and the gaps
+	return (int)len;
+}
+
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+	(void)spi;
+	return is_tx ? DREQ_SPI0_TX : DREQ_SPI0_TX + 1;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+	return &spi->hw;
+}
+
+/*** pwm ***/
+static struct {
+	uint32_t div;
+	uint32_t top;
+	uint16_t level[2];
+	bool enabled;
+	uint64_t start_us; // counter at 0
+	uint64_t wraps; // wraps whose dreq has been served since start_us
+} slices[HAL_PWM_SLICES];
+
+uint pwm_gpio_to_slice_num(uint gpio) {
+	return (gpio >> 1) & 7;
+}
+
+pwm_config pwm_get_default_config(void) {
+	pwm_config c = {1, 0xFFFF};
+	return c;
+}
+
+void pwm_config_set_clkdiv_int(pwm_config *c, uint div) {
+	c->div_int = div;
+}
+
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) {
+	c->top = wrap;
+}
+
+void pwm_set_counter(uint slice_num, uint16_t c) {
+	sigset_t old = hal_lock();
+	slices[slice_num].start_us = time_us_64() - (uint64_t)c * slices[slice_num].div / HAL_SYS_CLOCK_MHZ;
+	slices[slice_num].wraps = 0;
+	hal_unlock(old);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+	sigset_t old = hal_lock();
+	if (enabled && !slices[slice_num].enabled) {
+		slices[slice_num].start_us = time_us_64();
+		slices[slice_num].wraps = 0;
+	}
+	slices[slice_num].enabled = enabled;
+	hal_unlock(old);
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {
+	slices[slice_num].div = c->div_int;
+	slices[slice_num].top = c->top;
+	pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {
+	slices[slice_num].top = wrap;
+	if (!slices[slice_num].div) {
+		slices[slice_num].div = 1;
+	}
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+	slices[slice_num].level[chan] = level;
+}
+
+/*** adc: the LDR at hal.ldr_percent ***/
+void adc_init(void) {
+}
+
+void adc_gpio_init(uint gpio) {
+	(void)gpio;
+}
+
+void adc_select_input(uint input) {
+	(void)input;
+}
+
+uint16_t adc_read(void) {
+	float counts = hal.ldr_percent * (1 << 12) / 100;
+	return counts >= (1 << 12) ? (1 << 12) - 1 : (uint16_t)counts;
+}
+
+/*** dma: channels paced by a PWM wrap run on the engine thread, at the
+ * slice's period; others run to the end as soon as they are triggered.
+ * A 32-bit transfer moves a pointer-sized word, as it does on the chip ***/
+static struct {
+	bool claimed;
+	bool busy;
+	bool irq1;
+	dma_channel_config config;
+	uintptr_t reload; // transfer count loaded on each trigger
+} channels[HAL_DMA_CHANNELS];
+static uint32_t dma_irq1_raised; // channels which finished since the last check
+
+static size_t dma_size(enum dma_channel_transfer_size size) {
+	return size == DMA_SIZE_8 ? 1 : size == DMA_SIZE_16 ? 2 : sizeof(uintptr_t);
+}
+
+static bool dma_paced(uint channel) {
+	uint dreq = channels[channel].config.dreq;
+	return dreq >= DREQ_PWM_WRAP0 && dreq < DREQ_PWM_WRAP0 + HAL_PWM_SLICES;
+}
+
+static void dma_start(uint channel);
+
+/* one transfer of the channel, with the hal lock held */
+static void dma_transfer(uint channel) {
+	dma_channel_hw_t *ch = &dma_hw->ch[channel];
+	size_t size = dma_size(channels[channel].config.size);
+	uintptr_t value = 0;
+	memcpy(&value, (const void *)ch->read_addr, size);
+
+	if (ch->write_addr >= (uintptr_t)&dma_hw->ch[0] && ch->write_addr < (uintptr_t)&dma_hw->ch[HAL_DMA_CHANNELS]
+			&& (ch->write_addr - (uintptr_t)&dma_hw->ch[0]) % sizeof(dma_channel_hw_t)
+				== offsetof(dma_channel_hw_t, al3_read_addr_trig)) {
+		uint target = (ch->write_addr - (uintptr_t)&dma_hw->ch[0]) / sizeof(dma_channel_hw_t);
+		dma_hw->ch[target].read_addr = value;
+		dma_start(target);
+	} else if (ch->write_addr == (uintptr_t)&spi0->hw.dr) {
+		spi_frame((uint16_t)value);
+	} else {
+		memcpy((void *)ch->write_addr, &value, size);
+	}
+
+	if (channels[channel].config.read_increment) {
+		ch->read_addr += size;
+	}
+	if (channels[channel].config.write_increment) {
+		ch->write_addr += size;
+	}
+	if (--ch->transfer_count == 0) {
+		channels[channel].busy = false;
+		if (channels[channel].irq1) {
+			dma_irq1_raised |= 1u << channel;
+		}
+	}
+}
+
+static void dma_start(uint channel) {
+	dma_hw->ch[channel].transfer_count = channels[channel].reload;
+	channels[channel].busy = channels[channel].reload > 0;
+	while (channels[channel].busy && !dma_paced(channel)) {
+		dma_transfer(channel);
+	}
+}
+
+/* serve each enabled slice's wraps to the channels paced by it, then sleep
+ * to the next wrap */
+static void *dma_engine(void *arg) {
+	(void)arg;
+	while (1) {
+		sigset_t old = hal_lock();
+		uint64_t now = time_us_64();
+		uint64_t next = now + 1000;
+		for (uint s = 0; s < HAL_PWM_SLICES; s++) {
+			if (!slices[s].enabled) {
+				continue;
+			}
+			uint64_t period_us = (uint64_t)(slices[s].top + 1) * slices[s].div / HAL_SYS_CLOCK_MHZ;
+			if (period_us == 0) {
+				continue;
+			}
+			while (slices[s].start_us + (slices[s].wraps + 1) * period_us <= now) {
+				slices[s].wraps++;
+				for (uint c = 0; c < HAL_DMA_CHANNELS; c++) {
+					if (channels[c].busy && channels[c].config.dreq == DREQ_PWM_WRAP0 + s) {
+						dma_transfer(c);
+					}
+				}
+			}
+			uint64_t wrap = slices[s].start_us + (slices[s].wraps + 1) * period_us;
+			next = wrap < next ? wrap : next;
+		}
+		uint32_t raised = dma_irq1_raised;
+		dma_irq1_raised = 0;
+		hal_unlock(old);
+
+		if (raised) {
+			hal_irq_raise(DMA_IRQ_1);
+		}
+		hal_sleep_until(next);
+	}
+	return NULL;
+}
+
+int dma_claim_unused_channel(bool required) {
+	sigset_t old = hal_lock();
+	for (int c = 0; c < HAL_DMA_CHANNELS; c++) {
+		if (!channels[c].claimed) {
+			channels[c].claimed = true;
+			hal_unlock(old);
+			return c;
+		}
+	}
+	hal_unlock(old);
+	if (required) {
+		fprintf(stderr, "no dma channels left\n");
+		abort();
+	}
+	return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+	(void)channel;
+	dma_channel_config c = {DMA_SIZE_32, true, false, 0x3F};
+	return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+	c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+	c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+	c->write_increment = incr;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+	c->dreq = dreq;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+		const volatile void *read_addr, uint transfer_count, bool trigger) {
+	sigset_t old = hal_lock();
+	channels[channel].config = *config;
+	dma_hw->ch[channel].write_addr = (uintptr_t)write_addr;
+	dma_hw->ch[channel].read_addr = (uintptr_t)read_addr;
+	dma_hw->ch[channel].transfer_count = transfer_count;
+	channels[channel].reload = transfer_count;
+	if (trigger) {
+		dma_start(channel);
+	}
+	hal_unlock(old);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+	sigset_t old = hal_lock();
+	dma_hw->ch[channel].read_addr = (uintptr_t)read_addr;
+	if (trigger) {
+		dma_start(channel);
+	}
+	hal_unlock(old);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+	sigset_t old = hal_lock();
+	dma_hw->ch[channel].transfer_count = trans_count;
+	channels[channel].reload = trans_count;
+	if (trigger) {
+		dma_start(channel);
+	}
+	hal_unlock(old);
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+	sigset_t old = hal_lock();
+	channels[channel].irq1 = enabled;
+	hal_unlock(old);
+}
+
+bool dma_channel_is_busy(uint channel) {
+	sigset_t old = hal_lock();
+	bool busy = channels[channel].busy;
+	hal_unlock(old);
+	return busy;
+}
+
+/* stops the channel where it is; no irq is raised for it */
+void dma_channel_abort(uint channel) {
+	sigset_t old = hal_lock();
+	channels[channel].busy = false;
+	hal_unlock(old);
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+	while (dma_channel_is_busy(channel)) {
+		sched_yield();
+	}
+}
+
+/*** start up: this thread is core0 ***/
+void hal_init(void) {
+	pthread_t engine;
+	clock_gettime(CLOCK_MONOTONIC, &boot);
+	for (int i = 0; i < HAL_IRQ_COUNT; i++) {
+		irq_core[i] = -1;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = hal_irq_signal;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(HAL_IRQ_SIGNAL, &sa, NULL);
+
+	core_thread[0] = pthread_self();
+	hal_core = 0;
+	pthread_create(&engine, NULL, dma_engine, NULL);
+}
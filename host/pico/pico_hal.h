@@ -0,0 +1,185 @@
+#ifndef PICO_HAL_H
+#define PICO_HAL_H
+
+/*
+ * The parts of the Pico SDK the firmware uses, simulated on a Linux host.
+ * Each core is a thread; an irq is a signal sent to the thread of the core
+ * which enabled it, so its handler interrupts that core's main loop as on
+ * the chip. Spin locks mask those signals, as spin_lock_blocking masks
+ * interrupts. DMA channels paced by a PWM slice wrap are run by an engine
+ * thread with the slice's timing. The DHT22, the LDR and the UART link to
+ * the Wemos are driven by the host run, see hal_config.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t; // us since boot
+
+#define PICO_DEFAULT_LED_PIN 25
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/*** host run configuration, set before the firmware's main ***/
+typedef struct {
+	int uart_fd; // link to the Wemos
+	uint32_t timer_period_ms; // repeating timer period, 0 keeps the firmware's
+	float humidity; // DHT22 reading, %
+	float temp_celsius; // DHT22 reading, C
+	float ldr_percent; // LDR brightness, %
+} hal_config;
+
+extern hal_config hal;
+void hal_init(void); // after hal is filled in, before the firmware's main
+
+/*** time ***/
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+bool time_reached(absolute_time_t t);
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void stdio_init_all(void);
+
+struct repeating_timer;
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *t);
+struct repeating_timer {
+	int64_t delay_us;
+	repeating_timer_callback_t callback;
+	void *user_data;
+};
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback,
+	void *user_data, struct repeating_timer *out);
+
+/*** gpio ***/
+enum gpio_function { GPIO_FUNC_SPI = 1, GPIO_FUNC_UART = 2, GPIO_FUNC_PWM = 4, GPIO_FUNC_SIO = 5 };
+#define GPIO_OUT 1
+#define GPIO_IN 0
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+
+/*** irqs and multicore ***/
+#define TIMER_IRQ_0 0
+#define DMA_IRQ_1 12
+#define SIO_IRQ_PROC0 15
+#define SIO_IRQ_PROC1 16
+#define HAL_IRQ_COUNT 32
+typedef void (*irq_handler_t)(void);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+void multicore_launch_core1(void (*entry)(void));
+bool multicore_fifo_rvalid(void);
+bool multicore_fifo_wready(void);
+void multicore_fifo_push_blocking(uint32_t data);
+uint32_t multicore_fifo_pop_blocking(void);
+void multicore_fifo_clear_irq(void);
+
+/*** sync ***/
+typedef volatile uint32_t spin_lock_t;
+uint spin_lock_claim_unused(bool required);
+spin_lock_t *spin_lock_init(uint lock_num);
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+void __dmb(void);
+
+/*** uart ***/
+typedef struct { int index; } uart_inst_t;
+extern uart_inst_t hal_uart0;
+#define uart0 (&hal_uart0)
+typedef enum { UART_PARITY_NONE, UART_PARITY_EVEN, UART_PARITY_ODD } uart_parity_t;
+uint uart_init(uart_inst_t *uart, uint baudrate);
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity);
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+void uart_puts(uart_inst_t *uart, const char *s);
+
+/*** spi ***/
+typedef struct { volatile uintptr_t dr; } spi_hw_t;
+typedef struct { int index; spi_hw_t hw; } spi_inst_t;
+extern spi_inst_t hal_spi0;
+#define spi0 (&hal_spi0)
+typedef enum { SPI_CPOL_0, SPI_CPOL_1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0, SPI_CPHA_1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST, SPI_MSB_FIRST } spi_order_t;
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+int spi_write16_blocking(spi_inst_t *spi, const uint16_t *src, size_t len);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+
+/*** pwm ***/
+#define PWM_CHAN_A 0
+#define PWM_CHAN_B 1
+#define HAL_PWM_SLICES 8
+typedef struct {
+	uint32_t div_int;
+	uint32_t top;
+} pwm_config;
+uint pwm_gpio_to_slice_num(uint gpio);
+pwm_config pwm_get_default_config(void);
+void pwm_config_set_clkdiv_int(pwm_config *c, uint div);
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap);
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_counter(uint slice_num, uint16_t c);
+void pwm_set_enabled(uint slice_num, bool enabled);
+
+/*** adc ***/
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+uint16_t adc_read(void);
+
+/*** dma ***/
+#define HAL_DMA_CHANNELS 12
+#define DREQ_PWM_WRAP0 24
+#define DREQ_SPI0_TX 16
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+/* registers hold host addresses, so they are pointer-sized */
+typedef struct {
+	volatile uintptr_t read_addr;
+	volatile uintptr_t write_addr;
+	volatile uintptr_t transfer_count;
+	volatile uintptr_t al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+	dma_channel_hw_t ch[HAL_DMA_CHANNELS];
+	volatile uint32_t ints1; // write a channel's bit to acknowledge its irq
+} dma_hw_t;
+extern dma_hw_t hal_dma_hw;
+#define dma_hw (&hal_dma_hw)
+
+typedef struct {
+	enum dma_channel_transfer_size size;
+	bool read_increment;
+	bool write_increment;
+	uint dreq;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+	const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_abort(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+
+#endif
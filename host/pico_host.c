@@ -0,0 +1,47 @@
+/*
+ * The Pico firmware, built for the host against the simulated SDK in
+ * pico/. Its main runs as core0 on this thread; the UART to the Wemos is
+ * the socket passed as --uart-fd.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico_hal.h"
+
+#define main pico_main
+#include "pico_wifi.c"
+#undef main
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s --uart-fd FD [--timer-period-ms MS] [--humidity %%] "
+		"[--temperature C] [--ldr %%]\n", argv0);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+		} else if (!strcmp(argv[i], "--uart-fd")) {
+			hal.uart_fd = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--timer-period-ms")) {
+			hal.timer_period_ms = (uint32_t)atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--humidity")) {
+			hal.humidity = (float)atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--temperature")) {
+			hal.temp_celsius = (float)atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--ldr")) {
+			hal.ldr_percent = (float)atof(argv[++i]);
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if (hal.uart_fd < 0) {
+		usage(argv[0]);
+	}
+
+	hal_init();
+	return pico_main();
+}
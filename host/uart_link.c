@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+#include "uart_link.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static struct timespec to_timespec(uint64_t ns) {
+	struct timespec ts = {(time_t)(ns / 1000000000u), (long)(ns % 1000000000u)};
+	return ts;
+}
+
+/* shift the tx fifo out, one byte per frame time; a byte is written to the 
+ * socket once its last bit would have left */
+static void *uart_link_tx(void *arg) {
+	uart_link *u = arg;
+	uint64_t next = 0;
+	pthread_mutex_lock(&u->lock);
+	while (1) {
+		while (u->tx_count == 0) {
+			pthread_cond_wait(&u->tx_cond, &u->lock);
+		}
+		char c = u->tx[u->tx_head];
+		pthread_mutex_unlock(&u->lock);
+
+		uint64_t now = now_ns();
+		next = (next > now ? next : now) + u->byte_ns;
+		struct timespec ts = to_timespec(next);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+		}
+		if (write(u->fd, &c, 1) != 1) {
+			return NULL; // the other board is gone
+		}
+
+		pthread_mutex_lock(&u->lock);
+		u->tx_head = (u->tx_head + 1) % u->tx_size;
+		u->tx_count--;
+		pthread_cond_broadcast(&u->tx_cond);
+	}
+}
+
+/* bytes from the other board into the rx fifo; a full fifo drops them */
+static void *uart_link_rx(void *arg) {
+	uart_link *u = arg;
+	char buf[64];
+	int overrun = 0;
+	while (1) {
+		ssize_t n = read(u->fd, buf, sizeof(buf));
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			return NULL;
+		}
+		pthread_mutex_lock(&u->lock);
+		for (ssize_t i = 0; i < n; i++) {
+			if (u->rx_count == u->rx_size) {
+				u->overruns++;
+				if (!overrun) {
+					fprintf(stderr, "%s: uart rx overrun\n", u->name);
+				}
+				overrun = 1;
+				continue;
+			}
+			overrun = 0;
+			u->rx[(u->rx_head + u->rx_count) % u->rx_size] = buf[i];
+			u->rx_count++;
+		}
+		pthread_cond_broadcast(&u->rx_cond);
+		pthread_mutex_unlock(&u->lock);
+	}
+}
+
+void uart_link_open(uart_link *u, const char *name, int fd, uint32_t baud,
+		unsigned tx_size, unsigned rx_size) {
+	pthread_condattr_t attr;
+	u->name = name;
+	u->fd = fd;
+	u->byte_ns = 10 * 1000000000ull / baud;
+	u->tx_size = tx_size < UART_LINK_MAX_FIFO ? tx_size : UART_LINK_MAX_FIFO;
+	u->rx_size = rx_size < UART_LINK_MAX_FIFO ? rx_size : UART_LINK_MAX_FIFO;
+	u->tx_head = u->tx_count = 0;
+	u->rx_head = u->rx_count = 0;
+	u->overruns = 0;
+	pthread_mutex_init(&u->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&u->tx_cond, &attr);
+	pthread_cond_init(&u->rx_cond, &attr);
+	pthread_create(&u->tx_thread, NULL, uart_link_tx, u);
+	pthread_create(&u->rx_thread, NULL, uart_link_rx, u);
+}
+
+void uart_link_putc(uart_link *u, char c) {
+	pthread_mutex_lock(&u->lock);
+	while (u->tx_count == u->tx_size) {
+		pthread_cond_wait(&u->tx_cond, &u->lock);
+	}
+	u->tx[(u->tx_head + u->tx_count) % u->tx_size] = c;
+	u->tx_count++;
+	pthread_cond_broadcast(&u->tx_cond);
+	pthread_mutex_unlock(&u->lock);
+}
+
+unsigned uart_link_available(uart_link *u, uint32_t wait_us) {
+	pthread_mutex_lock(&u->lock);
+	if (u->rx_count == 0 && wait_us) {
+		struct timespec ts = to_timespec(now_ns() + wait_us * 1000ull);
+		pthread_cond_timedwait(&u->rx_cond, &u->lock, &ts);
+	}
+	unsigned n = u->rx_count;
+	pthread_mutex_unlock(&u->lock);
+	return n;
+}
+
+int uart_link_getc(uart_link *u) {
+	pthread_mutex_lock(&u->lock);
+	while (u->rx_count == 0) {
+		pthread_cond_wait(&u->rx_cond, &u->lock);
+	}
+	char c = u->rx[u->rx_head];
+	u->rx_head = (u->rx_head + 1) % u->rx_size;
+	u->rx_count--;
+	pthread_mutex_unlock(&u->lock);
+	return (unsigned char)c;
+}
@@ -0,0 +1,46 @@
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+/*
+ * One end of the serial link between the Pico and the Wemos, on a socket.
+ * Bytes leave at the baud rate, 10 bits per byte, through a tx fifo which
+ * blocks the writer when full, and arrive in an rx fifo which drops them
+ * when full, as the UARTs of both boards do.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UART_LINK_MAX_FIFO 4096
+
+typedef struct {
+	const char *name; // for the overrun message
+	int fd;
+	uint64_t byte_ns; // one frame at the baud rate
+	unsigned tx_size, rx_size;
+	char tx[UART_LINK_MAX_FIFO];
+	unsigned tx_head, tx_count;
+	char rx[UART_LINK_MAX_FIFO];
+	unsigned rx_head, rx_count;
+	unsigned long overruns;
+	pthread_mutex_t lock;
+	pthread_cond_t tx_cond; // tx fifo gained bytes or room
+	pthread_cond_t rx_cond; // rx fifo gained bytes
+	pthread_t tx_thread, rx_thread;
+} uart_link;
+
+void uart_link_open(uart_link *u, const char *name, int fd, uint32_t baud,
+	unsigned tx_size, unsigned rx_size);
+void uart_link_putc(uart_link *u, char c);
+unsigned uart_link_available(uart_link *u, uint32_t wait_us); // waits up to wait_us for a byte
+int uart_link_getc(uart_link *u); // blocks until a byte arrives
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * The Wemos sketch, built for the host against the ESP8266 core shims in
+ * arduino/. The UART to the Pico is the socket passed as --uart-fd, and the
+ * broker is the one given by --broker instead of broker.h's.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arduino.h"
+
+// the prototypes the Arduino IDE generates for the sketch
+void initMQTTClient(int verbose);
+void subscribeToDeviceTopics();
+bool connectMQTT();
+void setupMQTT();
+void setupWiFi();
+void reconnect();
+void setDateTime();
+unsigned long unixTime();
+void shortBlink(int duration);
+void printToMCU(char* topic, byte* payload, unsigned int length);
+bool readFromMCU();
+void callback(char* topic, byte* payload, unsigned int length);
+void handleFromMCU();
+
+#include "wemos-wifi.ino"
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "usage: %s --uart-fd FD [--broker HOST:PORT]\n", argv0);
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+    } else if (!strcmp(argv[i], "--uart-fd")) {
+      arduino_host.uart_fd = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--broker")) {
+      char* broker = argv[++i];
+      char* colon = strrchr(broker, ':');
+      if (!colon) {
+        usage(argv[0]);
+      }
+      *colon = '\0';
+      arduino_host.broker_host = broker;
+      arduino_host.broker_port = (uint16_t)atoi(colon + 1);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (arduino_host.uart_fd < 0) {
+    usage(argv[0]);
+  }
+
+  setup();
+  for (;;) {
+    loop();
+  }
+}
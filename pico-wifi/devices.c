@@ -1,15 +1,165 @@
 #include "devices.h"
 
-/* writes to digipot via SPI */
+/* digipot ramp state: one row of frames per ramp step, one frame per
+ * digipot in the chain; the control channel hands each row's address to
+ * the data channel on every tick of the pacing slice */
+uint16_t digipot_frames[DIGIPOT_MAX_STEPS][DIGIPOT_CHAIN_LENGTH];
+const uint16_t *digipot_steps[DIGIPOT_MAX_STEPS];
+uint8_t digipot_levels[DIGIPOT_CHAIN_LENGTH]; // last values written to the chain
+uint8_t digipot_targets[DIGIPOT_CHAIN_LENGTH]; // values at the end of the ramp
+uint8_t digipot_pending_value = 0; // device value reported once ramp is done
+int digipot_ctrl_chan = -1;
+int digipot_data_chan = -1;
+
+/* register write for one digipot: address byte (msb=0 for write), then value */
+uint16_t digipot_frame(uint8_t value) {
+	return ((REGADDR & 0x7F) << 8) | value;
+}
+
+/* writes one value to every digipot in the chain via SPI; CS is driven
+ * by the SPI block and stays asserted for the whole chain */
 void write_to_digipot(uint8_t intensity) {
-	uint8_t data[2];
-	data[0] = REGADDR & 0x7F; // set msb=0 to indicate write op
-	data[1] = intensity; // actual value to be written
+	uint16_t data[DIGIPOT_CHAIN_LENGTH];
+	for (int k = 0; k < DIGIPOT_CHAIN_LENGTH; k++) {
+		data[k] = digipot_frame(intensity);
+		digipot_levels[k] = intensity;
+	}
+	spi_write16_blocking(SPI_PORT, data, DIGIPOT_CHAIN_LENGTH);
+}
+
+/* set up SPI, the ramp pacing slice, and the two DMA channels; called 
+ * from core1 so that ramp completion is handled there */
+void digipot_init() {
+	spi_init(SPI_PORT, DIGIPOT_COMM_SPEED);
+	spi_set_format(SPI_PORT, 16, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+	gpio_set_function(SCK, GPIO_FUNC_SPI);
+	gpio_set_function(SPI_TX, GPIO_FUNC_SPI);
+	gpio_set_function(CS, GPIO_FUNC_SPI);
+
+	/* 1MHz count, one wrap per PWM_SET_DELAY; the DMA timers cannot 
+	 * pace as slowly as a ramp step, a PWM wrap can */
+	pwm_config pacing = pwm_get_default_config();
+	pwm_config_set_clkdiv_int(&pacing, 125);
+	pwm_config_set_wrap(&pacing, PWM_SET_DELAY * 1000 - 1);
+	pwm_init(DIGIPOT_PACING_SLICE, &pacing, false);
+
+	digipot_ctrl_chan = dma_claim_unused_channel(true);
+	digipot_data_chan = dma_claim_unused_channel(true);
+
+	/* data channel: one row of frames into the SPI tx fifo, started 
+	 * by a write to its read address trigger */
+	dma_channel_config data_config = dma_channel_get_default_config(digipot_data_chan);
+	channel_config_set_transfer_data_size(&data_config, DMA_SIZE_16);
+	channel_config_set_read_increment(&data_config, true);
+	channel_config_set_write_increment(&data_config, false);
+	channel_config_set_dreq(&data_config, spi_get_dreq(SPI_PORT, true));
+	dma_channel_configure(digipot_data_chan, &data_config, &spi_get_hw(SPI_PORT)->dr, 
+		NULL, DIGIPOT_CHAIN_LENGTH, false);
+
+	/* control channel: one row address per pacing tick */
+	dma_channel_config ctrl_config = dma_channel_get_default_config(digipot_ctrl_chan);
+	channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+	channel_config_set_read_increment(&ctrl_config, true);
+	channel_config_set_write_increment(&ctrl_config, false);
+	channel_config_set_dreq(&ctrl_config, DREQ_PWM_WRAP0 + DIGIPOT_PACING_SLICE);
+	dma_channel_configure(digipot_ctrl_chan, &ctrl_config, 
+		&dma_hw->ch[digipot_data_chan].al3_read_addr_trig, digipot_steps, 0, false);
+
+	dma_channel_set_irq1_enabled(digipot_ctrl_chan, true);
+	irq_set_exclusive_handler(DMA_IRQ_1, digipot_dma_handler);
+	irq_set_enabled(DMA_IRQ_1, true);
+
+	write_to_digipot(0);
+}
+
+/* stop a running ramp, keeping the levels of the last step written */
+void digipot_abort() {
+	dma_channel_set_irq1_enabled(digipot_ctrl_chan, false);
+	dma_channel_abort(digipot_ctrl_chan);
+	dma_channel_wait_for_finish_blocking(digipot_data_chan);
+	dma_hw->ints1 = 1u << digipot_ctrl_chan; // abort may raise the irq anyway
+	dma_channel_set_irq1_enabled(digipot_ctrl_chan, true);
+	pwm_set_enabled(DIGIPOT_PACING_SLICE, false);
+
+	uint steps_done = (const uint16_t **)dma_hw->ch[digipot_ctrl_chan].read_addr - digipot_steps;
+	if (steps_done > 0) {
+		for (int k = 0; k < DIGIPOT_CHAIN_LENGTH; k++) {
+			digipot_levels[k] = digipot_frames[steps_done - 1][DIGIPOT_CHAIN_LENGTH - 1 - k] & 0xFF;
+		}
+	}
+}
+
+/* precompute a ramp from the current levels to the targets, one unit per 
+ * step for each digipot, and hand it to DMA; returns without waiting. 
+ * The first frame shifted out ends up in the last digipot of the chain.
+ * value is reported once the ramp is done; it is set only after the 
+ * previous ramp is aborted, as that ramp's irq would report it as reached */
+void digipot_ramp(const uint8_t *targets, uint8_t value) {
+	if (dma_channel_is_busy(digipot_ctrl_chan) || dma_channel_is_busy(digipot_data_chan)) {
+		digipot_abort();
+	}
+	digipot_pending_value = value;
+
+	uint8_t level[DIGIPOT_CHAIN_LENGTH];
+	uint steps = 0;
+	uint8_t moving = 1;
+	for (int k = 0; k < DIGIPOT_CHAIN_LENGTH; k++) {
+		level[k] = digipot_levels[k];
+		digipot_targets[k] = targets[k];
+	}
+
+	while (moving && steps < DIGIPOT_MAX_STEPS) {
+		moving = 0;
+		for (int k = 0; k < DIGIPOT_CHAIN_LENGTH; k++) {
+			if (level[k] < targets[k]) {
+				level[k]++;
+			} else if (level[k] > targets[k]) {
+				level[k]--;
+			}
+			moving |= (level[k] != targets[k]);
+			digipot_frames[steps][DIGIPOT_CHAIN_LENGTH - 1 - k] = digipot_frame(level[k]);
+		}
+		digipot_steps[steps] = digipot_frames[steps];
+		steps++;
+	}
+
+	pwm_set_counter(DIGIPOT_PACING_SLICE, 0);
+	dma_channel_set_read_addr(digipot_ctrl_chan, digipot_steps, false);
+	dma_channel_set_trans_count(digipot_ctrl_chan, steps, true);
+	pwm_set_enabled(DIGIPOT_PACING_SLICE, true);
+}
+
+/* ramp finished: the control channel is done once the last row has been 
+ * handed over, so wait out that row before reporting the device value */
+void digipot_dma_handler() {
+	dma_hw->ints1 = 1u << digipot_ctrl_chan;
+	dma_channel_wait_for_finish_blocking(digipot_data_chan);
+	pwm_set_enabled(DIGIPOT_PACING_SLICE, false);
+
+	for (int k = 0; k < DIGIPOT_CHAIN_LENGTH; k++) {
+		digipot_levels[k] = digipot_targets[k];
+	}
 
-	// do the sending
-	gpio_put(CS, 0); // set chip select to "write"
-	spi_write_blocking(SPI_PORT, data, 2);
-	gpio_put(CS, 1);
+	// device updates only available for posting after writing done
+	g_devices[DIGIPOT_DEVICE] = digipot_pending_value;
+	post_device_change(DIGIPOT_DEVICE);
+}
+
+/* ramp every digipot in the chain to the same intensity, 0 to 100 */
+uint8_t digipot_change(uint8_t desired_intensity) {
+	uint8_t targets[DIGIPOT_CHAIN_LENGTH];
+	uint8_t value = (uint8_t)map_to_pwm((long)desired_intensity, 
+		MIN_INCOMING_INPUT, MAX_INCOMING_INPUT, 0, MAX_VAL);
+
+	if (desired_intensity == g_devices[DIGIPOT_DEVICE] && !dma_channel_is_busy(digipot_ctrl_chan)) {
+		return 0;
+	}
+
+	for (int k = 0; k < DIGIPOT_CHAIN_LENGTH; k++) {
+		targets[k] = value;
+	}
+	digipot_ramp(targets, desired_intensity);
+	return 1;
 }
 
 /* calculate wrap point for the PWM. The wrap point determines
@@ -38,11 +188,11 @@ long map_to_pwm(long x, long in_min, long in_max, long out_min, long out_max) {
  * the LED device is sensitive to only 10% of the duty cycle 
  * given to MOSFET 20kHz; command mapped to that 10%.
  * */
-void smooth_change(uint8_t desired_intensity, uint device_index) {
+uint8_t smooth_change(uint8_t desired_intensity, uint device_index) {
 	uint8_t current_intensity = g_devices[device_index];
 
 	if (desired_intensity == current_intensity) {
-		return;
+		return 0;
 	}
 
 	/* set the scaling factor for the target device */
@@ -70,17 +220,56 @@ void smooth_change(uint8_t desired_intensity, uint device_index) {
 
 	// device updates only available for posting after writing done
 	g_devices[device_index] = desired_intensity;
-	g_device_being_changed = device_index;
-	g_dcif = 1;	
+	post_device_change(device_index);
+	return 1;
+}
+
+/* mark a device change for core0 to report; safe from core1 and its irqs.
+ * A change caused by a remote command also closes that command's trace */
+void post_device_change(uint device_index) {
+	uint32_t done_us = time_us_32();
+	uint32_t save = spin_lock_blocking(g_device_change_lock);
+	g_devices_changed |= (1u << device_index);
+	if (g_trace_rx_us[device_index]) {
+		g_trace_latency_us[device_index][0] = g_trace_irq_us[device_index] - g_trace_rx_us[device_index];
+		g_trace_latency_us[device_index][1] = done_us - g_trace_irq_us[device_index];
+		g_trace_latency_us[device_index][2] = done_us - g_trace_rx_us[device_index];
+		g_devices_traced |= (1u << device_index);
+		g_trace_rx_us[device_index] = 0;
+	}
+	spin_unlock(g_device_change_lock, save);
+}
+
+/* drop the trace of a command which changed nothing, so it is not 
+ * attributed to a later change */
+void drop_device_trace(uint device_index) {
+	uint32_t save = spin_lock_blocking(g_device_change_lock);
+	g_trace_rx_us[device_index] = 0;
+	spin_unlock(g_device_change_lock, save);
+}
+
+/* take all pending device changes, on core0; traced gets the devices 
+ * whose latencies in g_trace_latency_us are to be reported */
+uint32_t take_device_changes(uint32_t *traced) {
+	uint32_t save = spin_lock_blocking(g_device_change_lock);
+	uint32_t changed = g_devices_changed;
+	*traced = g_devices_traced;
+	g_devices_changed = 0;
+	g_devices_traced = 0;
+	spin_unlock(g_device_change_lock, save);
+	return changed;
 }
 
 /* device output changes; only LED device for now;
  * this can also be modelled as an array of functions 
  * */
-void change_device_output(uint8_t device_index, uint32_t device_value) {
+uint8_t change_device_output(uint8_t device_index, uint32_t device_value) {
 	if (device_index == LED_DEVICE) {
-		smooth_change(device_value, device_index);
+		return smooth_change(device_value, device_index);
+	} else if (device_index == DIGIPOT_DEVICE) {
+		return digipot_change(device_value);
 	}
+	return 0;
 }
 
 /*** device mode changes ***/
@@ -114,7 +303,9 @@ uint8_t ldr_led_linear(float ldr_reading) {
 
 /* general response of LED to ldr sensor readings */
 void ldr_led_response() {
-	float ldr_reading = g_sensors[LDR_SENSOR];
+	sensor_snapshot snapshot;
+	sensor_snapshot_read(&g_sensor_snapshot, &snapshot);
+	float ldr_reading = snapshot.values[LDR_SENSOR];
 	uint8_t linear_response = 0;
 	if (ldr_reading > (float)LDR_DAYLIGHT_VISIBILITY) {
 		g_ldr_anchor = (float)LDR_DAYLIGHT_VISIBILITY;
@@ -144,7 +335,12 @@ void ldr_led_shutdown() {
 
 /* device command protocol implemented here */
 uint32_t encode_command(uint32_t value, uint32_t index, uint32_t msb) {
-	return value | ((!!index)<<(16+index)) | msb;
+	return value | (index << 16) | msb;
+}
+
+/* device index from the fifo command: bits 16 to 30 */
+uint32_t decode_device_index(uint32_t cmd) {
+	return (cmd & ~DEVICE_MODE_BIT) >> 16;
 }
 
 uint32_t decode_command(uint32_t cmd) {
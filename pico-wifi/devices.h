@@ -31,22 +31,37 @@
 // device indices 
 #define NO_DEVICE (-1)
 #define LED_DEVICE 0
+#define DIGIPOT_DEVICE 1
 
 // digipot LED intensity and addressing parameters
 #define MAX_VAL 0x7F // 127; actual max 128 or 0x80
 #define FLOOR_VAL 0x32 // 50; light is barely visible below this
 #define REGADDR 0x00
+#define DIGIPOT_MAX_STEPS (MAX_VAL + 1) // longest ramp, 0 to MAX_VAL inclusive
+
+#if DIGIPOT_CHAIN_LENGTH > 8
+#error "digipot chain must fit the SPI tx fifo to be written in one CS assertion"
+#endif
 
 
 // function declarations
 typedef void (*operation_mode)(void);
 
 void write_to_digipot(uint8_t intensity);
+uint16_t digipot_frame(uint8_t value);
+void digipot_init();
+void digipot_abort();
+void digipot_ramp(const uint8_t *targets, uint8_t value);
+void digipot_dma_handler();
+uint8_t digipot_change(uint8_t desired_intensity);
 uint32_t wrap_point_of_freq(uint hertz);
-void smooth_change(uint8_t desired_intensity, uint device_index);
+uint8_t smooth_change(uint8_t desired_intensity, uint device_index);
 long map_to_pwm(long x, long in_min, long in_max, long out_min, long out_max);
 
-void change_device_output(uint8_t device_index, uint32_t device_value);
+void post_device_change(uint device_index);
+void drop_device_trace(uint device_index);
+uint32_t take_device_changes(uint32_t *traced);
+uint8_t change_device_output(uint8_t device_index, uint32_t device_value);
 
 void change_device_mode(uint8_t device_index, uint8_t device_mode, uint8_t *modeflag);
 uint8_t ldr_led_linear(float ldr_reading);
@@ -56,6 +71,7 @@ void ldr_led_shutdown();
 
 uint32_t encode_command(uint32_t value, uint32_t index, uint32_t msb);
 uint32_t decode_command(uint32_t cmd);
+uint32_t decode_device_index(uint32_t cmd);
 uint8_t check_core1_status(uint8_t dmf, uint8_t dcf);
 
 #endif
\ No newline at end of file
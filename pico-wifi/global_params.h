@@ -3,15 +3,21 @@
 
 #include "devices.h"
 #include "sensors.h"
+#include "history.h"
 
 // mark all with g_ ??
-extern uint8_t g_device_being_changed;
-extern uint8_t g_dcif; // flag must be global for device policies
+extern uint32_t g_devices_changed; // bit per device with a change to report
+extern spin_lock_t *g_device_change_lock; // guards g_devices_changed across cores and irqs
 extern uint8_t g_devices[DEVICE_COUNT];
 extern uint8_t g_modes[DEVICE_COUNT];
-extern float g_sensors[SENSOR_COUNT];
+extern sensor_seqlock g_sensor_snapshot;
+extern history_ring g_history[SENSOR_COUNT];
 extern float g_ldr_anchor; // last value for which device0 output changed
 extern uint32_t g_wrap_point; // for the LED PWM
+extern uint32_t g_trace_rx_us[DEVICE_COUNT]; // stamps of the command in progress, 0 if none
+extern uint32_t g_trace_irq_us[DEVICE_COUNT];
+extern uint32_t g_trace_latency_us[DEVICE_COUNT][3]; // rx->core1, core1->done, total
+extern uint32_t g_devices_traced; // bit per device with a latency to report
 
 extern operation_mode g_device_operation_modes[DEVICE_COUNT];
 extern operation_mode g_device_shutdown_policies[DEVICE_COUNT];
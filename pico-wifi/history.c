@@ -0,0 +1,205 @@
+#include "history.h"
+
+/* add a sample from core1; a new block starts when the current one is 
+ * full, the delta does not fit a byte, or a sample was missed. The 
+ * count is published after the data, so core0 only reads written samples */
+void history_append(history_ring *ring, float value, uint32_t tick) {
+	int16_t sample = (int16_t)lroundf(value * HISTORY_FIXED_POINT);
+	history_block *block = &ring->blocks[ring->head];
+	int32_t delta = (int32_t)sample - ring->last;
+
+	if (ring->used == 0 || block->count > HISTORY_BLOCK_SAMPLES 
+		|| delta > INT8_MAX || delta < INT8_MIN
+		|| tick != block->start_tick + block->count * ring->period_ticks) {
+		if (ring->used > 0) {
+			ring->head = (ring->head + 1) % ring->block_count;
+			block = &ring->blocks[ring->head];
+		}
+		block->count = 0; // oldest block is recycled; readers skip it
+		__dmb();
+		block->start_tick = tick;
+		block->base = sample;
+		__dmb();
+		block->count = 1;
+		if (ring->used < ring->block_count) {
+			ring->used++;
+		}
+	} else {
+		block->deltas[block->count - 1] = (int8_t)delta;
+		__dmb();
+		block->count++;
+	}
+	ring->last = sample;
+}
+
+/* set up a query for the samples between from_s and to_s seconds ago,
+ * summarised in buckets of bucket_s seconds, or raw if bucket_s is 0 */
+void history_query_begin(history_query *q, history_ring *ring, uint8_t sensor, 
+	uint32_t from_s, uint32_t to_s, uint32_t bucket_s, uint32_t now_tick) {
+	uint32_t from_ticks = from_s / HISTORY_TICK_S; // no s * 1000, it overflows past 49 days
+	uint32_t to_ticks = to_s / HISTORY_TICK_S;
+
+	q->sensor = sensor;
+	q->query_tick = now_tick;
+	q->from_tick = (from_ticks < now_tick) ? now_tick - from_ticks : 0;
+	q->to_tick = (to_ticks < now_tick) ? now_tick - to_ticks : 0;
+	q->bucket_ticks = bucket_s / HISTORY_TICK_S;
+	if (bucket_s > 0 && q->bucket_ticks == 0) {
+		q->bucket_ticks = 1; // finer than a tick is one tick, not raw samples
+	}
+
+	// cursor starts at the oldest block in the ring
+	q->blocks_left = ring->used;
+	q->block = (ring->head + ring->block_count - ring->used + 1) % ring->block_count;
+	q->sample = 0;
+	q->n = 0;
+	q->held = 0;
+	q->next_chunk = get_absolute_time();
+	q->active = 1;
+}
+
+/* next sample at the cursor, oldest first; returns 0 once the ring is 
+ * exhausted. Whole blocks older than the range are skipped */
+uint8_t history_next(history_query *q, history_ring *ring, uint32_t *tick, int16_t *value) {
+	while (q->blocks_left > 0) {
+		history_block *block = &ring->blocks[q->block];
+		uint8_t count = *(volatile uint8_t *)&block->count;
+		__dmb();
+
+		if (q->sample == 0 && count > 0 
+			&& block->start_tick + (count - 1) * ring->period_ticks < q->from_tick) {
+			count = 0; // all of it before the range
+		}
+
+		if (q->sample < count) {
+			if (q->sample == 0) {
+				q->value = block->base;
+			} else {
+				q->value += block->deltas[q->sample - 1];
+			}
+			*tick = block->start_tick + q->sample * ring->period_ticks;
+			*value = q->value;
+			q->sample++;
+			return 1;
+		}
+
+		// the newest block may still be filling; it is read up to its current count
+		q->block = (q->block + 1) % ring->block_count;
+		q->blocks_left--;
+		q->sample = 0;
+	}
+	return 0;
+}
+
+/* next sample within the query range, a held one first; returns 0 once
+ * the range is exhausted */
+uint8_t history_range_next(history_query *q, history_ring *ring, uint32_t *tick, int16_t *value) {
+	if (q->held) {
+		*tick = q->held_tick;
+		*value = q->held_value;
+		q->held = 0;
+		return 1;
+	}
+
+	while (history_next(q, ring, tick, value)) {
+		if (*tick < q->from_tick) {
+			continue;
+		}
+		if (*tick > q->to_tick) {
+			q->blocks_left = 0; // rest of the ring is newer than the range
+			return 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/* start a new bucket with its first sample */
+void history_bucket_begin(history_query *q, uint32_t tick, int16_t value) {
+	q->bucket_start = tick - (tick - q->from_tick) % q->bucket_ticks;
+	q->sum = value;
+	q->min = value;
+	q->max = value;
+	q->n = 1;
+}
+
+/* write the summary of the current bucket as one reply line */
+void history_bucket_flush(history_query *q, char *out) {
+	sprintf(out, history_bucket_format, q->sensor, 
+		(unsigned long)((q->query_tick - q->bucket_start) * HISTORY_TICK_S),
+		(float)q->min / HISTORY_FIXED_POINT,
+		(float)q->sum / q->n / HISTORY_FIXED_POINT,
+		(float)q->max / HISTORY_FIXED_POINT);
+	q->n = 0;
+}
+
+/* produce the next reply line of a query into out; returns 0 when there
+ * is no line to send yet. Raw samples fill a line while they are one
+ * period apart and fit. A bucket is summarised over as many calls as it
+ * takes, at most HISTORY_STEP_SAMPLES samples per call, with its partial
+ * sums kept in q. The last line of every query is an end marker */
+uint8_t history_query_step(history_query *q, history_ring *ring, char *out) {
+	uint32_t tick = 0;
+	uint32_t next_tick = 0;
+	int16_t value = 0;
+	int len = 0;
+	uint16_t budget = HISTORY_STEP_SAMPLES;
+	uint8_t more = 0;
+
+	if (!q->active) {
+		return 0;
+	}
+
+	while ((more = history_range_next(q, ring, &tick, &value))) {
+		if (q->bucket_ticks == 0) {
+			if (len == 0) {
+				len = sprintf(out, history_sample_format, q->sensor, 
+					(unsigned long)((q->query_tick - tick) * HISTORY_TICK_S),
+					(unsigned long)(ring->period_ticks * HISTORY_TICK_S));
+			} else if (tick != next_tick || len + HISTORY_VALUE_CHARS + 1 >= HISTORY_BUFFER) {
+				q->held = 1; // gap or full line; it starts the next one
+				q->held_tick = tick;
+				q->held_value = value;
+				break;
+			}
+			len += sprintf(out + len, history_value_format, (float)value / HISTORY_FIXED_POINT);
+			next_tick = tick + ring->period_ticks;
+			continue;
+		}
+
+		if (q->n == 0) {
+			history_bucket_begin(q, tick, value);
+		} else if (tick >= q->bucket_start + q->bucket_ticks) {
+			history_bucket_flush(q, out);
+			history_bucket_begin(q, tick, value);
+			return 1;
+		} else {
+			q->sum += value;
+			q->min = MIN(q->min, value);
+			q->max = MAX(q->max, value);
+			q->n++;
+		}
+
+		if (--budget == 0) {
+			break; // rest of the bucket on the next call
+		}
+	}
+
+	if (len > 0) {
+		strcpy(out + len, ";");
+		return 1;
+	}
+
+	if (more) {
+		return 0;
+	}
+
+	if (q->n > 0) {
+		history_bucket_flush(q, out);
+		return 1;
+	}
+
+	sprintf(out, history_end_format, q->sensor);
+	q->active = 0;
+	return 1;
+}
@@ -0,0 +1,78 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "pico/stdlib.h"
+#include "sensors.h"
+
+/* sensor history kept in RAM: samples in fixed point, delta encoded in
+ * blocks, each sensor with its own ring of blocks. Time is counted in 
+ * timer ticks (TIMER_PERIOD) since boot */
+#define HISTORY_TICK_S (TIMER_PERIOD / 1000) // queries and replies count whole seconds
+#define HISTORY_RETENTION_S (2*24*3600) // two days at full sample rate
+#define HISTORY_BLOCK_SAMPLES 56 // deltas per block; blocks are 64 bytes
+#define HISTORY_FIXED_POINT 10 // samples stored in tenths
+#define HISTORY_CHUNK_PERIOD_MS 250 // one reply line per period, so the Wemos keeps up
+#define HISTORY_STEP_SAMPLES 256 // most samples read per step, so core0 gets back to the uart
+
+#if TIMER_PERIOD % 1000
+#error "history ages are whole seconds; TIMER_PERIOD must be a multiple of 1000 ms"
+#endif
+
+// blocks needed to cover the retention for a sensor read every period_ticks
+#define HISTORY_BLOCKS(period_ticks) \
+	((HISTORY_RETENTION_S / HISTORY_TICK_S) / ((period_ticks) * (HISTORY_BLOCK_SAMPLES + 1)) + 2)
+
+typedef struct {
+	uint32_t start_tick; // tick of the base sample
+	int16_t base; // first sample, fixed point
+	uint8_t count; // samples in block, base included
+	uint8_t reserved;
+	int8_t deltas[HISTORY_BLOCK_SAMPLES]; // deltas[i] = sample[i+1] - sample[i]
+} history_block;
+
+typedef struct {
+	history_block *blocks;
+	uint16_t block_count;
+	uint16_t period_ticks; // ticks between samples
+	uint16_t head; // block being filled
+	uint16_t used; // blocks holding samples
+	int16_t last; // newest sample, fixed point
+} history_ring;
+
+/* a range query over one sensor, streamed one line at a time. Raw 
+ * samples are packed several to a line */
+typedef struct {
+	uint8_t active;
+	uint8_t sensor;
+	uint32_t query_tick; // ages in replies are relative to this
+	uint32_t from_tick; // oldest tick included
+	uint32_t to_tick; // newest tick included
+	uint32_t bucket_ticks; // 0 for raw samples
+	// cursor over the ring
+	uint16_t block;
+	uint16_t blocks_left;
+	uint8_t sample;
+	int16_t value;
+	// sample read but left for the next line
+	uint8_t held;
+	uint32_t held_tick;
+	int16_t held_value;
+	// summary of the current bucket
+	uint32_t bucket_start;
+	int32_t sum;
+	int16_t min;
+	int16_t max;
+	uint32_t n;
+	absolute_time_t next_chunk;
+} history_query;
+
+void history_append(history_ring *ring, float value, uint32_t tick);
+void history_query_begin(history_query *q, history_ring *ring, uint8_t sensor, 
+	uint32_t from_s, uint32_t to_s, uint32_t bucket_s, uint32_t now_tick);
+void history_bucket_begin(history_query *q, uint32_t tick, int16_t value);
+void history_bucket_flush(history_query *q, char *out);
+uint8_t history_next(history_query *q, history_ring *ring, uint32_t *tick, int16_t *value);
+uint8_t history_range_next(history_query *q, history_ring *ring, uint32_t *tick, int16_t *value);
+uint8_t history_query_step(history_query *q, history_ring *ring, char *out);
+
+#endif
@@ -23,6 +23,8 @@
 #include "hardware/uart.h"
 #include "hardware/pwm.h"
 #include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -37,25 +39,37 @@
 // .c file; try changing CMakeLists
 #include "sensors.c" 
 #include "devices.c"
+#include "history.c"
 
 /* flags: used to indicate pending tasks in main loops of core0 and core1.
  * not used as mutex; Pico does not have CPU cycle management and thus 
  * no more than 1 thread per core */
 uint8_t spf = 0; // signal time to publish sensor data
 uint8_t srdf = 0; // sensor read DHT22 flag
-uint8_t swf = 0; // write flag for sensor array
 uint8_t srlf = 0; // sensor read ldr flag
 uint8_t maf = 0; // modes active flag
-uint8_t g_dcif = 0; // global device command implemented flag
 uint8_t dcf = 0; // device command to be implemented
 uint8_t dmf = 0; // device mode to be implemented
 uint8_t service_denied = 0; // core1 can't take task as previous unfinished
 
 /* parameters for devices and sensors, visible throughout program */
-uint8_t g_device_being_changed = NO_DEVICE;
+uint32_t g_devices_changed = 0; // bit per device with a change to report
+spin_lock_t *g_device_change_lock;
 uint8_t g_devices[DEVICE_COUNT] = {0, 0};
 uint8_t g_modes[DEVICE_COUNT] = {0, 0}; // index corresponds to device
-float g_sensors[SENSOR_COUNT] = {0.0, 0.0, 0.0};
+sensor_seqlock g_sensor_snapshot; // readings, published by core1
+
+/* sensor history, each ring sized to the retention at its sensor's read period */
+history_block humid_history[HISTORY_BLOCKS(SENSOR_DHT_READ_PERIOD)];
+history_block temp_history[HISTORY_BLOCKS(SENSOR_DHT_READ_PERIOD)];
+history_block ldr_history[HISTORY_BLOCKS(SENSOR_LDR_READ_PERIOD)];
+history_ring g_history[SENSOR_COUNT] = {
+	{humid_history, HISTORY_BLOCKS(SENSOR_DHT_READ_PERIOD), SENSOR_DHT_READ_PERIOD, 0, 0, 0},
+	{temp_history, HISTORY_BLOCKS(SENSOR_DHT_READ_PERIOD), SENSOR_DHT_READ_PERIOD, 0, 0, 0},
+	{ldr_history, HISTORY_BLOCKS(SENSOR_LDR_READ_PERIOD), SENSOR_LDR_READ_PERIOD, 0, 0, 0}
+};
+history_query sensor_history_query; // core0 only
+
 float g_ldr_anchor = 0.0; // last value for which device0 output changed
 uint32_t g_wrap_point = 1000; // initial default for PWM
 uint32_t device_mask = 1<<16; // at compile time; otherwise, fix, do in main()
@@ -64,6 +78,14 @@ uint timer_count = 0;
 uint32_t g_device_value = 0;
 uint8_t g_device_index = LED_DEVICE;
 
+/* timestamps for latency tracing of device commands, us since boot;
+ * a zero rx stamp means the device change was not remotely commanded */
+uint32_t g_trace_command_us = 0; // command line complete on core0, before the fifo push
+uint32_t g_trace_rx_us[DEVICE_COUNT]; // the above, once core1 accepted the command
+uint32_t g_trace_irq_us[DEVICE_COUNT]; // command picked up by core1
+uint32_t g_trace_latency_us[DEVICE_COUNT][3];
+uint32_t g_devices_traced = 0;
+
 operation_mode g_device_operation_modes[DEVICE_COUNT] = 
 	{&ldr_led_response, &no_operation};
 operation_mode g_device_shutdown_policies[DEVICE_COUNT] = 
@@ -82,18 +104,21 @@ void core1_interrupt_handler() {
 		irq_command = multicore_fifo_pop_blocking();
 	}
 	multicore_fifo_clear_irq();
+	uint32_t irq_us = time_us_32();
 
 	/* service denied -> previous change flags were not cleared; 
 	 * consider adding further info on what and why */
 	service_denied = check_core1_status(dmf, dcf);
-	if ((service_denied > 0) {
+	if (service_denied > 0) {
 		return;
 	}	
 
 	/* extract the device index from the fifo command: upper 16 bits */
-	while (( (irq_command & ~DEVICE_MODE_BIT) >> (16+device_index)) != 0) {
-		device_index++;
+	uint32_t command_index = decode_device_index(irq_command);
+	if (command_index >= DEVICE_COUNT) {
+		return;
 	}
+	device_index = command_index;
 
 	/* extract desired device intensity: lower 16 bits, 0 - 65535 */
 	device_value = irq_command % device_mask;
@@ -109,6 +134,10 @@ void core1_interrupt_handler() {
 	}
 
 	if (command_type == DEVICE_OUTPUT_BIT) {
+		uint32_t save = spin_lock_blocking(g_device_change_lock);
+		g_trace_rx_us[device_index] = g_trace_command_us;
+		g_trace_irq_us[device_index] = irq_us;
+		spin_unlock(g_device_change_lock, save);
 		dcf = 1;
 	}
 
@@ -129,6 +158,9 @@ void core1_main() {
 	irq_set_exclusive_handler(SIO_IRQ_PROC1, core1_interrupt_handler);
 	irq_set_enabled(SIO_IRQ_PROC1, true);
 
+	// digipot output stage; its ramp completion irq is serviced on core1
+	digipot_init();
+
 	while(1) {
 		/*** sensor tasks ***/
 		/* read DHT22 based on timer flag */
@@ -138,33 +170,48 @@ void core1_main() {
 			if (read_valid = read_from_dht(&reading)) {
 				// if (reading.humidity < 0.001 
 				// && reading.temp_celsius < 0.001) {/* don't write to array*/}
-				swf = 1; // start writing
-				g_sensors[HUMID_SENSOR] = reading.humidity;
-				g_sensors[TEMP_SENSOR] = reading.temp_celsius;
-				swf = 0; // end writing
+				uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+				sensor_snapshot *snapshot = sensor_snapshot_begin(&g_sensor_snapshot);
+				snapshot->values[HUMID_SENSOR] = reading.humidity;
+				snapshot->values[TEMP_SENSOR] = reading.temp_celsius;
+				snapshot->captured_ms[HUMID_SENSOR] = now_ms;
+				snapshot->captured_ms[TEMP_SENSOR] = now_ms;
+				snapshot->valid |= (1<<HUMID_SENSOR) | (1<<TEMP_SENSOR);
+				sensor_snapshot_publish(&g_sensor_snapshot); // both from the same read
+				// stamp with the scheduled tick, a retried read still lands in its slot
+				uint32_t dht_tick = timer_count - timer_count % SENSOR_DHT_READ_PERIOD;
+				history_append(&g_history[HUMID_SENSOR], reading.humidity, dht_tick);
+				history_append(&g_history[TEMP_SENSOR], reading.temp_celsius, dht_tick);
 				srdf = 0; // sensor has been read
 			}
 		}
 
 		/* read ldr based on timer flag */
 		if (srlf) {
-			swf = 1; // start writing
 			uint16_t ldr_reading = adc_read();
-			g_sensors[LDR_SENSOR] = ldr_reading * ldr_cf;
-			swf = 0; // end writing
+			sensor_snapshot *snapshot = sensor_snapshot_begin(&g_sensor_snapshot);
+			snapshot->values[LDR_SENSOR] = ldr_reading * ldr_cf;
+			snapshot->captured_ms[LDR_SENSOR] = to_ms_since_boot(get_absolute_time());
+			snapshot->valid |= (1<<LDR_SENSOR);
+			sensor_snapshot_publish(&g_sensor_snapshot);
+			history_append(&g_history[LDR_SENSOR], ldr_reading * ldr_cf, 
+				timer_count - timer_count % SENSOR_LDR_READ_PERIOD);
 			srlf = 0; // ldr has been read
 		}
 
 		/*** device tasks ***/
 		/* if device output command was received, and no modes active, carry it out */
 		if (dcf && g_modes[g_device_index] == 0) { 
-			change_device_output(g_device_index, g_device_value);
+			if (!change_device_output(g_device_index, g_device_value)) {
+				drop_device_trace(g_device_index); // nothing changed, nothing to time
+			}
 			// smooth_change(g_device_value, g_device_index); 
 			dcf = 0;
 		}
 
 		/* if device mode was received, change mode accordingly */
 		if (dmf) {
+			drop_device_trace(g_device_index); // a mode change is not a timed command
 			change_device_mode(g_device_index, g_device_value, &maf);
 			dmf = 0;
 		}
@@ -195,8 +242,8 @@ bool repeating_timer_callback(struct repeating_timer *t) {
 		srlf = 1; 
 	}
 
-	// flag the sensor array for publishing (core0) when no writing is done
-	if (((timer_count % SENSOR_PUBLISH_PERIOD) == 0) && (swf == 0)) {
+	// flag the sensor snapshot for publishing (core0); reading it never waits on core1
+	if (((timer_count % SENSOR_PUBLISH_PERIOD) == 0)) {
 		spf = 1; 
 	}
 
@@ -239,6 +286,9 @@ int main() {
     struct repeating_timer timer;
     add_repeating_timer_ms(TIMER_PERIOD, repeating_timer_callback, NULL, &timer);
     
+	// device change reports are posted from core1 and its irqs, taken on core0
+	g_device_change_lock = spin_lock_init(spin_lock_claim_unused(true));
+
 	// start core1 activity with its own main function
 	sleep_ms(50);
 	multicore_launch_core1(core1_main);
@@ -276,7 +326,9 @@ int main() {
 
 					    // package the device specifier into val, send data to core1 if no mode active					    
 						device_value = encode_command(device_value, device_index, DEVICE_OUTPUT_BIT);
-						if (g_modes[device_index] == 0 && multicore_fifo_wready()) {
+						if (device_index < DEVICE_COUNT && g_modes[device_index] == 0 
+							&& multicore_fifo_wready()) {
+							g_trace_command_us = time_us_32();
 							multicore_fifo_push_blocking(device_value);
 						}						
 					}
@@ -289,11 +341,25 @@ int main() {
 
 					    // package the device specifier into val, send data to core1
 					    device_mode = encode_command(device_mode, device_index, DEVICE_MODE_BIT);
-						if (multicore_fifo_wready()) {
+						if (device_index < DEVICE_COUNT && multicore_fifo_wready()) {
 							multicore_fifo_push_blocking(device_mode);
 						}
 					}
 
+					/* sensor history query; replaces any query still streaming */
+					if (strstr(msg_from_wifi, history_query_message) != NULL) {
+					    unsigned long sensor_index = 0;
+					    unsigned long from_s = 0;
+					    unsigned long to_s = 0;
+					    unsigned long bucket_s = 0;
+					    if (sscanf(msg_from_wifi, history_query_format, 
+					    		&sensor_index, &from_s, &to_s, &bucket_s) == 4 
+					    	&& sensor_index < SENSOR_COUNT) {
+					    	history_query_begin(&sensor_history_query, &g_history[sensor_index], 
+					    		sensor_index, from_s, to_s, bucket_s, timer_count);
+					    }
+					}
+
 				}
 				payload_size = 0;
 			} 
@@ -301,24 +367,56 @@ int main() {
 
 		/*** sending messages over UART to the wemos ***/
 		/* write stable sensor data to Tx periodically */
-		if (spf && !swf) {
+		if (spf) {
+			sensor_snapshot snapshot;
+			sensor_snapshot_read(&g_sensor_snapshot, &snapshot);
+			uint32_t now_ms = to_ms_since_boot(get_absolute_time());
 			for(int i = 0; i < SENSOR_COUNT; i++) {
-				sprintf(sensor_buffer_out, sensor_message_format, i, g_sensors[i]);
+				// never read, or stale after repeated bad reads
+				if (!(snapshot.valid & (1<<i)) 
+					|| (now_ms - snapshot.captured_ms[i]) > SENSOR_MAX_AGE_MS) {
+					continue;
+				}
+				sprintf(sensor_buffer_out, sensor_message_format, i, snapshot.values[i]);
 				uart_puts(UART_ID, sensor_buffer_out);
 				uart_puts(UART_ID, "\n");				
 			}
 			spf = 0; 
 		}
 
-		/* write the implemented device value to Tx once it is 
+		/* write the implemented device values to Tx once they are
 		 * carried out and written to D array */
-		if (g_dcif && (g_device_being_changed > NO_DEVICE)) {
-			sprintf(device_buffer_out, device_message_format, 
-				g_device_being_changed, g_devices[g_device_being_changed]);
+		uint32_t devices_traced = 0;
+		uint32_t devices_changed = take_device_changes(&devices_traced);
+		for (int i = 0; i < DEVICE_COUNT; i++) {
+			if (!(devices_changed & (1u << i))) {
+				continue;
+			}
+			sprintf(device_buffer_out, device_message_format, i, g_devices[i]);
 			uart_puts(UART_ID, device_buffer_out);
 			uart_puts(UART_ID, "\n");
-			g_device_being_changed = NO_DEVICE;
-			g_dcif = 0;
+
+			/* per-stage latency of the command which caused this change */
+			if (LATENCY_TRACE && (devices_traced & (1u << i))) {
+				sprintf(latency_buffer_out, latency_message_format, i,
+					(unsigned long)g_trace_latency_us[i][0],
+					(unsigned long)g_trace_latency_us[i][1],
+					(unsigned long)g_trace_latency_us[i][2]);
+				uart_puts(UART_ID, latency_buffer_out);
+				uart_puts(UART_ID, "\n");
+			}
+		}
+
+		/* stream a pending history query, one line per chunk period; a step 
+		 * which is still summarising a bucket sends nothing and is resumed 
+		 * on the next pass, after the uart has been read */
+		if (sensor_history_query.active && time_reached(sensor_history_query.next_chunk)) {
+			if (history_query_step(&sensor_history_query, 
+				&g_history[sensor_history_query.sensor], history_buffer_out)) {
+				uart_puts(UART_ID, history_buffer_out);
+				uart_puts(UART_ID, "\n");
+				sensor_history_query.next_chunk = make_timeout_time_ms(HISTORY_CHUNK_PERIOD_MS);
+			}
 		}
 
 		/* inform the WiFi module if a service has been denied */
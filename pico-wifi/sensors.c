@@ -48,4 +48,37 @@ uint8_t read_from_dht(dht_reading *result) {
     } else {
     	return 0; // bad read
     }
+}
+
+/* writer side, core1 only: returns the back buffer holding a copy of the 
+ * current snapshot, for the caller to update before publishing it */
+sensor_snapshot *sensor_snapshot_begin(sensor_seqlock *lock) {
+    uint32_t seq = lock->sequence;
+    sensor_snapshot *front = &lock->buffers[(seq >> 1) & 1];
+    sensor_snapshot *back = &lock->buffers[((seq >> 1) + 1) & 1];
+
+    lock->sequence = seq + 1; // odd: back buffer being written
+    __dmb();
+    *back = *front;
+    return back;
+}
+
+/* writer side: make the back buffer the front one */
+void sensor_snapshot_publish(sensor_seqlock *lock) {
+    __dmb();
+    lock->sequence = lock->sequence + 1;
+}
+
+/* reader side, any core or irq: copies the front buffer. It is only 
+ * overwritten once the writer has published and begun again, so a copy 
+ * is retried only if the writer laps the reader */
+void sensor_snapshot_read(sensor_seqlock *lock, sensor_snapshot *out) {
+    uint32_t first, last;
+    do {
+        first = lock->sequence;
+        __dmb();
+        *out = lock->buffers[(first >> 1) & 1];
+        __dmb();
+        last = lock->sequence;
+    } while (last - (first & ~1u) > 2);
 }
\ No newline at end of file
@@ -2,13 +2,14 @@
 #define SENSORS_H
 
 #define SENSOR_COUNT 3 // temperature, humidity, brightness
-#define DEVICE_COUNT 2 // LED and a placeholder
+#define DEVICE_COUNT 2 // LED and digipot
 #define TIMER_PERIOD 2000 // every 2 seconds
 
 // reading and publishing as multiples of timer period
 #define SENSOR_PUBLISH_PERIOD 10 // send to WiFi module every 2*10 seconds
 #define SENSOR_DHT_READ_PERIOD 3 // *2 seconds
 #define SENSOR_LDR_READ_PERIOD 1 // *2 seconds
+#define SENSOR_MAX_AGE_MS (TIMER_PERIOD * SENSOR_PUBLISH_PERIOD) // older readings are not published
 
 // LDR empirical constants
 #define LDR_DAYLIGHT_VISIBILITY 40
@@ -35,6 +36,24 @@ typedef struct {
     float temp_celsius;
 } dht_reading;
 
+/* all sensor readings at one point, with a validity bit per sensor */
+typedef struct {
+    float values[SENSOR_COUNT];
+    uint32_t captured_ms[SENSOR_COUNT]; // ms since boot when each value was read
+    uint8_t valid; // bit per sensor index, set once it has a good reading
+} sensor_snapshot;
+
+/* double-buffered snapshot under a sequence lock: core1 is the only writer,
+ * readers on core0 and in irqs never wait for it. An odd sequence means the 
+ * back buffer is being written; the front buffer is (sequence >> 1) & 1 */
+typedef struct {
+    volatile uint32_t sequence;
+    sensor_snapshot buffers[2];
+} sensor_seqlock;
+
 uint8_t read_from_dht(dht_reading *result);
+sensor_snapshot *sensor_snapshot_begin(sensor_seqlock *lock);
+void sensor_snapshot_publish(sensor_seqlock *lock);
+void sensor_snapshot_read(sensor_seqlock *lock, sensor_snapshot *out);
 
 #endif
\ No newline at end of file
@@ -11,4 +11,11 @@
 #define SPI_RX 4 // unused for digipot control
 #define CS 5
 
+// digipot output stage; SPI mode 3 keeps CS asserted across back-to-back
+// frames, so a daisy chain of up to 8 digipots (SPI fifo depth) is written
+// within one CS assertion
+#define DIGIPOT_COMM_SPEED 10000000 // 10MHz; COMM_SPEED works as well
+#define DIGIPOT_CHAIN_LENGTH 1 // digipots daisy-chained on CS, up to 8
+#define DIGIPOT_PACING_SLICE 7 // PWM slice not routed to a pin; its wrap paces ramps
+
 #endif
\ No newline at end of file
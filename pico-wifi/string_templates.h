@@ -4,20 +4,34 @@
 #define BUFFER_SIZE 512
 #define SENSOR_BUFFER 16
 #define DEVICE_BUFFER 16
+#define HISTORY_BUFFER 64 // whole lines must fit PENDING_LINE_SIZE on the Wemos
+#define HISTORY_VALUE_CHARS 8 // ",-3276.8", the widest value in a history line
 
 // enumerated comments
 #define PICO_COMMENTS 0
 #define WIFI_COMMENTS 1
 
+// per-stage latency reports for device commands; 1 for benchmark builds
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE 0
+#endif
+
 // text templates 
 const char* comment_message = "C"; // for misc. messages
 const char* device_message = "D";
 const char* sensor_message = "S";
 const char* mode_message = "M";
+const char* history_query_message = "Q";
 const char* comment_message_format = "C%d=[%s];";
 const char* device_message_format = "D%d=%d;";
 const char* sensor_message_format = "S%d=%f;";
 const char* mode_message_format = "M%d=%d;";
+const char* history_query_format = "Q%lu=%lu,%lu,%lu;"; // sensor, from s ago, to s ago, bucket s
+const char* history_sample_format = "H%d=%lu,%lu"; // sensor, age s of first value, s between values
+const char* history_value_format = ",%.1f"; // appended per sample, then ';'
+const char* history_bucket_format = "H%d=%lu,%.1f,%.1f,%.1f;"; // sensor, age s, min, mean, max
+const char* history_end_format = "H%d=END;";
+const char* latency_message_format = "L%d=%lu,%lu,%lu;"; // us: rx->core1, core1->done, total
 const char* pico_response_title = "PICO_ECHO";
 const char* service_denied_default = "SERVICE DENIED: CORE1 BUSY";
 
@@ -25,6 +39,8 @@ const char* service_denied_default = "SERVICE DENIED: CORE1 BUSY";
 char msg_from_wifi[BUFFER_SIZE];
 char sensor_buffer_out[SENSOR_BUFFER];
 char device_buffer_out[DEVICE_BUFFER];
+char latency_buffer_out[SENSOR_BUFFER*3];
+char history_buffer_out[HISTORY_BUFFER];
 char comment_buffer_out[BUFFER_SIZE];
 
 #endif
\ No newline at end of file
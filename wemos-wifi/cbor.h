@@ -0,0 +1,129 @@
+/*
+ * Minimal CBOR (RFC 8949) encoder for the binary payload topics. It writes
+ * into a caller's buffer and never allocates; a write past the end of the
+ * buffer sets overflow and the payload must not be published.
+ *
+ * Payloads are maps with small integer keys, which stay stable:
+ *   0: Unix time, seconds since 1970 UTC (unsigned)
+ *   1: temperature, C (float32)
+ *   2: relative humidity, % (float32)
+ *   3: brightness, % (float32)
+ *   4: device index (unsigned)
+ *   5: device value (unsigned)
+ *   6: sensor index (unsigned)
+ *   7: sensor value (float32)
+ * sensors/cbor/instant and sensors/cbor/hourly carry {0,1,2,3}, hourly with 
+ * the epoch at the start of the hour; sensors/<name>/cbor carry {0,6,7};
+ * devices/<name>/cbor carry {0,4,5}.
+ */
+
+#define CBOR_BUFFER_SIZE (64)
+
+#define CBOR_KEY_EPOCH 0
+#define CBOR_KEY_TEMPERATURE 1
+#define CBOR_KEY_HUMIDITY 2
+#define CBOR_KEY_BRIGHTNESS 3
+#define CBOR_KEY_DEVICE_INDEX 4
+#define CBOR_KEY_DEVICE_VALUE 5
+#define CBOR_KEY_SENSOR_INDEX 6
+#define CBOR_KEY_SENSOR_VALUE 7
+
+// major types
+#define CBOR_UINT 0
+#define CBOR_MAP 5
+#define CBOR_FLOAT32 0xFA
+
+typedef struct {
+  uint8_t* buf;
+  size_t size;
+  size_t len;
+  bool overflow;
+} cbor_writer;
+
+void cbor_init(cbor_writer* w, uint8_t* buf, size_t size) {
+  w->buf = buf;
+  w->size = size;
+  w->len = 0;
+  w->overflow = false;
+}
+
+void cbor_put(cbor_writer* w, uint8_t b) {
+  if (w->len < w->size) {
+    w->buf[w->len++] = b;
+  } else {
+    w->overflow = true;
+  }
+}
+
+/* initial byte and argument, in the shortest form */
+void cbor_head(cbor_writer* w, uint8_t major, uint32_t value) {
+  major <<= 5;
+  if (value < 24) {
+    cbor_put(w, major | value);
+  } else if (value <= 0xFF) {
+    cbor_put(w, major | 24);
+    cbor_put(w, value);
+  } else if (value <= 0xFFFF) {
+    cbor_put(w, major | 25);
+    cbor_put(w, value >> 8);
+    cbor_put(w, value);
+  } else {
+    cbor_put(w, major | 26);
+    cbor_put(w, value >> 24);
+    cbor_put(w, value >> 16);
+    cbor_put(w, value >> 8);
+    cbor_put(w, value);
+  }
+}
+
+void cbor_map(cbor_writer* w, uint32_t pairs) {
+  cbor_head(w, CBOR_MAP, pairs);
+}
+
+void cbor_uint(cbor_writer* w, uint32_t value) {
+  cbor_head(w, CBOR_UINT, value);
+}
+
+/* float32, big-endian */
+void cbor_float(cbor_writer* w, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  cbor_put(w, CBOR_FLOAT32);
+  cbor_put(w, bits >> 24);
+  cbor_put(w, bits >> 16);
+  cbor_put(w, bits >> 8);
+  cbor_put(w, bits);
+}
+
+/*** payloads ***/
+void cbor_sensor_datapoint(cbor_writer* w, uint32_t epoch, float temperature, float humidity, float brightness) {
+  cbor_map(w, 4);
+  cbor_uint(w, CBOR_KEY_EPOCH);
+  cbor_uint(w, epoch);
+  cbor_uint(w, CBOR_KEY_TEMPERATURE);
+  cbor_float(w, temperature);
+  cbor_uint(w, CBOR_KEY_HUMIDITY);
+  cbor_float(w, humidity);
+  cbor_uint(w, CBOR_KEY_BRIGHTNESS);
+  cbor_float(w, brightness);
+}
+
+void cbor_sensor_value(cbor_writer* w, uint32_t epoch, uint32_t sensor_index, float value) {
+  cbor_map(w, 3);
+  cbor_uint(w, CBOR_KEY_EPOCH);
+  cbor_uint(w, epoch);
+  cbor_uint(w, CBOR_KEY_SENSOR_INDEX);
+  cbor_uint(w, sensor_index);
+  cbor_uint(w, CBOR_KEY_SENSOR_VALUE);
+  cbor_float(w, value);
+}
+
+void cbor_device(cbor_writer* w, uint32_t epoch, uint32_t device_index, uint32_t device_value) {
+  cbor_map(w, 3);
+  cbor_uint(w, CBOR_KEY_EPOCH);
+  cbor_uint(w, epoch);
+  cbor_uint(w, CBOR_KEY_DEVICE_INDEX);
+  cbor_uint(w, device_index);
+  cbor_uint(w, CBOR_KEY_DEVICE_VALUE);
+  cbor_uint(w, device_value);
+}
@@ -0,0 +1,170 @@
+/*
+ * Fast-start support: what is needed to rejoin the network quickly after a
+ * reset or power blip is cached in RTC user memory, which survives resets,
+ * and mirrored to LittleFS, which survives power loss. The cache holds the
+ * AP channel and BSSID, the last DHCP lease for an optional static IP, and
+ * the last NTP time, used to validate the broker certificate until NTP
+ * completes again.
+ *
+ * Nothing here touches the hardware: WiFi, the clock, the broker and the
+ * cache storage are reached through fast_start_io. The sketch binds it to
+ * ESP8266WiFi, the SDK clock, PubSubClient and RTC memory/LittleFS; the
+ * host tests in host/ bind it to stubs.
+ */
+
+#define BOOT_CACHE_MAGIC 0x57424331 // "WBC1"
+#define BOOT_CACHE_RTC_OFFSET 0 // in 4-byte blocks of RTC user memory
+#define BOOT_CACHE_FILE "/boot.cache"
+#define BOOT_TIME_RTC_PERIOD_S 3600 // last_time refreshed in RTC memory hourly
+#define BOOT_TIME_FLASH_PERIOD_S (7 * 24 * 3600) // and on flash weekly, to spare it
+#define FAST_START_TIMEOUT_MS 5000 // cached AP given up after this, for a full scan
+#define MQTT_RETRY_MS 2000
+
+// boot milestones, ms since reset, for time-to-first-publish
+#define BOOT_WIFI 0
+#define BOOT_MQTT 1
+#define BOOT_NTP 2
+#define BOOT_FIRST_PUBLISH 3
+#define BOOT_MILESTONES 4
+
+typedef struct {
+  uint32_t crc; // over everything after this field
+  uint32_t magic;
+  uint8_t channel;
+  uint8_t bssid[6];
+  uint8_t has_lease;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t last_time; // epoch seconds, refreshed while NTP time is known
+} boot_cache;
+
+/* the network, clock, broker and storage, as fast start uses them */
+typedef struct {
+  unsigned long (*millis)();
+  time_t (*now)(); // wall clock; before NTP completes, close to 0
+  void (*wifi_begin)(bool cached); // associate, with the cached AP if asked
+  void (*wifi_rescan)(); // cached AP gave no answer: full scan and DHCP
+  bool (*wifi_connected)();
+  void (*wifi_joined)(); // first association this boot: cache the AP and lease
+  bool (*mqtt_connect)(time_t cert_time); // one attempt, certificate checked at cert_time
+  bool (*mqtt_publish)(const char* topic, const char* payload, bool retained);
+  void (*store_cache)(boot_cache* cache, bool to_flash); // RTC memory, and flash if asked
+} fast_start_io;
+
+const char* boot_report_format = "B%d=%lu,%lu,%lu,%lu;"; // cached AP used; ms to WiFi, broker, NTP, first publish
+
+// fast start state
+boot_cache bootCache;
+bool bootCacheLoaded = false;
+bool fastAssociation = false; // associating with the cached channel and BSSID
+bool bootReported = false;
+unsigned long wifiStartMs = 0;
+unsigned long lastMQTTAttemptMs = 0;
+time_t lastTimeFlashed = 0; // last_time as last written to flash
+unsigned long boot_ms[BOOT_MILESTONES] = {0, 0, 0, 0};
+
+uint32_t bootCacheCRC(const boot_cache* cache) {
+  const uint8_t* data = (const uint8_t*)cache + sizeof(cache->crc);
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < sizeof(boot_cache) - sizeof(cache->crc); i++) {
+    crc ^= data[i];
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+bool bootCacheValid(const boot_cache* cache) {
+  return cache->magic == BOOT_CACHE_MAGIC && cache->crc == bootCacheCRC(cache);
+}
+
+/* seal the cache before it is stored */
+void bootCacheSeal(boot_cache* cache) {
+  cache->magic = BOOT_CACHE_MAGIC;
+  cache->crc = bootCacheCRC(cache);
+}
+
+bool timeSynced(time_t now) {
+  return now >= 8 * 3600 * 2;
+}
+
+/* record a milestone the first time it is reached */
+void bootMilestone(int milestone, const fast_start_io* io) {
+  if (boot_ms[milestone] == 0) {
+    boot_ms[milestone] = io->millis();
+  }
+}
+
+/*** nothing here waits on the network ***/
+/* begin association; with a cached channel and BSSID the scan is skipped */
+void startWiFi(const fast_start_io* io) {
+  fastAssociation = bootCacheLoaded && bootCache.channel != 0;
+  io->wifi_begin(fastAssociation);
+  wifiStartMs = io->millis();
+}
+
+/* one step towards a broker connection, with at most one MQTT attempt */
+void connectStep(const fast_start_io* io) {
+  if (!io->wifi_connected()) {
+    // cached AP gone or moved: fall back to a full scan and DHCP
+    if (fastAssociation && io->millis() - wifiStartMs > FAST_START_TIMEOUT_MS) {
+      fastAssociation = false;
+      io->wifi_rescan();
+    }
+    return;
+  }
+
+  if (boot_ms[BOOT_WIFI] == 0) {
+    bootMilestone(BOOT_WIFI, io);
+    io->wifi_joined();
+  }
+
+  if (lastMQTTAttemptMs != 0 && io->millis() - lastMQTTAttemptMs < MQTT_RETRY_MS) {
+    return;
+  }
+  lastMQTTAttemptMs = io->millis();
+
+  // until NTP completes, the certificate is checked against the last known time
+  time_t now = io->now();
+  if (io->mqtt_connect(timeSynced(now) ? now : bootCache.last_time)) {
+    bootMilestone(BOOT_MQTT, io);
+  }
+}
+
+/* note when NTP completes in the background, and keep its time for the next
+ * boot. A cached time that is months old would fail a certificate issued
+ * since, so it is refreshed hourly in RTC memory and weekly on flash */
+void timeStep(const fast_start_io* io) {
+  time_t now = io->now();
+  if (!timeSynced(now)) {
+    return;
+  }
+
+  if (boot_ms[BOOT_NTP] == 0) {
+    bootMilestone(BOOT_NTP, io);
+    bootCache.last_time = now;
+    io->store_cache(&bootCache, true);
+    lastTimeFlashed = now;
+  } else if (now - (time_t)bootCache.last_time >= BOOT_TIME_RTC_PERIOD_S) {
+    bool to_flash = now - lastTimeFlashed >= BOOT_TIME_FLASH_PERIOD_S;
+    bootCache.last_time = now;
+    io->store_cache(&bootCache, to_flash);
+    if (to_flash) {
+      lastTimeFlashed = now;
+    }
+  }
+}
+
+/* publish the boot milestones once, after the first publish and NTP sync */
+void reportBoot(const char* topic, const fast_start_io* io) {
+  char msg[64];
+  if (bootReported || boot_ms[BOOT_FIRST_PUBLISH] == 0 || boot_ms[BOOT_NTP] == 0) {
+    return;
+  }
+  sprintf(msg, boot_report_format, fastAssociation ? 1 : 0, boot_ms[BOOT_WIFI],
+    boot_ms[BOOT_MQTT], boot_ms[BOOT_NTP], boot_ms[BOOT_FIRST_PUBLISH]);
+  bootReported = io->mqtt_publish(topic, msg, true);
+}
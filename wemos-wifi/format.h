@@ -6,11 +6,27 @@
 #define SILENT 0
 #define VERBOSE 1
 #define DEBUG 0
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE 0 // 1 for benchmark builds, reports on topic_latency
+#endif
+
+// fast start: forward from boot, join the network and broker in the background
+#define FAST_START 0 // 1 once validated on the hardware; 0 keeps the blocking boot
+#define FAST_START_STATIC_IP 0 // 1 reuses the cached DHCP lease, skipping DHCP
+
+// payload encodings, per topic group; either or both
+#define ENCODING_TEXT 1
+#define ENCODING_CBOR 2
+const int sensor_value_encoding = ENCODING_TEXT; // sensors/<name>/value, sensors/<name>/cbor
+const int sensor_datapoint_encoding = ENCODING_TEXT; // sensors/json/*, sensors/cbor/*
+const int device_status_encoding = ENCODING_TEXT; // devices/<name>/status, devices/<name>/cbor
 
 // buffers for messages coming from Pico or as MQTT payload
 char sensors_datapoint_json_msg[MSG_BUFFER_SIZE];
 char device_json_msg[MSG_BUFFER_SIZE];
 char debugging_msg[MSG_BUFFER_SIZE];
+char latency_msg[MSG_BUFFER_SIZE];
+uint8_t cbor_msg[CBOR_BUFFER_SIZE];
 
 // additional from HiveMQ
 unsigned long lastMsg = 0;
@@ -23,25 +39,38 @@ int ledPin = LED_BUILTIN;
 
 // state variables. offline devices are -1, and offline sensors are -100.0
 const int sensors_online_qty = 3; // for now, humidity, temperature, LDR light intensity are being read
-const int devices_online_qty = 1; // LED light
+const int devices_online_qty = 2; // LED light, digipot
 int sensors_updated = 0;
 int sensors_online = 0;
 
 float sensor_array[sensors_online_qty] = {-100.0, -100.0, -100.0}; // humidity, temperature, LDR light intensity
 float sensor_array_old[sensors_online_qty] = {-100.0, -100.0, -100.0};
-int device_array[2] = {-1, -1}; // LED and a placeholder device
+int device_array[2] = {-1, -1}; // LED and digipot
 int device_array_old[2] = {-1, -1};
 
+// latency tracing; millis() when a device command arrived, and when a sensor cycle began
+unsigned long device_command_ms[2] = {0, 0}; // 0 once echoed, replaced, or dropped by the Pico
+int device_command_value[2] = {0, 0}; // value of the stamped command
+int device_reported[2] = {-1, -1}; // last device values echoed by the Pico
+unsigned long sensor_cycle_start_ms = 0;
+
 // message templates 
 const char* device_message_format = "D%d=%d;";
 const char* sensor_message_format = "S%d=%f;";
 const char* mode_message_format = "M%d=%d;";
 const char* comment_message_format = "C%d=[%s];";
+const char* service_denied_comment = "SERVICE DENIED"; // Pico's comment when core1 drops a command
+const char* latency_device_format = "W%d=%lu;"; // ms from MQTT callback to Pico echo
+const char* latency_sensor_format = "WS=%lu;"; // ms from first sensor line to datapoint publish
 
 // device topics, data received from remote, forwarded to MCU. 
 const char* topic_device0_status = "devices/LED_0/status";
 const char* topic_device0_value = "devices/LED_0/value";
 const char* topic_device0_mode = "devices/LED_0/mode";
+const char* topic_device1_status = "devices/digipot_0/status";
+const char* topic_device1_value = "devices/digipot_0/value";
+const char* topic_device0_cbor = "devices/LED_0/cbor";
+const char* topic_device1_cbor = "devices/digipot_0/cbor";
 
 // sensor topics, data generated by the MCU and pushed to wifi when avbl
 const char* topic_sensor0_status = "sensors/humidity/status";
@@ -50,18 +79,28 @@ const char* topic_sensor1_status = "sensors/temperature/status";
 const char* topic_sensor1_value = "sensors/temperature/value";
 const char* topic_sensor2_status = "sensors/brightness/status";
 const char* topic_sensor2_value = "sensors/brightness/value";
+const char* topic_sensor0_cbor = "sensors/humidity/cbor";
+const char* topic_sensor1_cbor = "sensors/temperature/cbor";
+const char* topic_sensor2_cbor = "sensors/brightness/cbor";
 const char* topic_sensors_datapoint = "sensors/json"; 
 const char* topic_sensors_datapoint_hourly = "sensors/json/hourly"; 
 const char* topic_sensors_datapoint_instant = "sensors/json/instant"; 
+const char* topic_sensors_cbor_hourly = "sensors/cbor/hourly"; 
+const char* topic_sensors_cbor_instant = "sensors/cbor/instant"; 
+const char* topic_sensors_history = "sensors/history"; // H%d=...; lines streamed from the Pico
+const char* topic_sensors_history_query = "sensors/history/query"; // Q%d=from,to,bucket; forwarded to the Pico
 
 const char* sensor_topics[sensors_online_qty] = {topic_sensor0_value, topic_sensor1_value, topic_sensor2_value};
+const char* sensor_cbor_topics[sensors_online_qty] = {topic_sensor0_cbor, topic_sensor1_cbor, topic_sensor2_cbor};
 
-const char* device_json_topics[devices_online_qty] = {topic_device0_status};
+const char* device_json_topics[devices_online_qty] = {topic_device0_status, topic_device1_status};
+const char* device_cbor_topics[devices_online_qty] = {topic_device0_cbor, topic_device1_cbor};
 
 // general MCU and wifi module status topics
 const char* topic_pico_status = "pico/status";
 const char* topic_wifi_status = "wifi/status";
 const char* topic_general = "general";
+const char* topic_latency = "bench/latency";
 
 // time
 const char* utc_timezone = "02:00";
@@ -0,0 +1,62 @@
+/*
+ * Lines from the Pico: assembled from the serial bytes as they arrive, and
+ * held in order while the broker is unreachable. No Arduino calls here;
+ * the host tests in host/ feed it directly. MSG_BUFFER_SIZE is format.h's.
+ */
+
+#define PENDING_LINES 16 // Pico lines held until the broker is reachable
+#define PENDING_LINE_SIZE 64
+
+char mcu_line[MSG_BUFFER_SIZE]; // Pico line being assembled
+int mcu_line_len = 0;
+bool mcu_line_overlong = false;
+char pending_lines[PENDING_LINES][PENDING_LINE_SIZE];
+int pending_head = 0; // oldest held line
+int pending_count = 0;
+
+/* one byte from the Pico into mcu_line; once it completes a line, the line
+ * with its '\n' is copied into out and true returned. Lines arrive over
+ * several reads at 115200 baud, and a partial line is never handed on.
+ * An overlong line is dropped */
+bool mcuLineFeed(char c, char* out) {
+  if (mcu_line_len >= MSG_BUFFER_SIZE - 1) {
+    mcu_line_len = 0; // no line is this long; resync on the next '\n'
+    mcu_line_overlong = true;
+  }
+  mcu_line[mcu_line_len++] = c;
+  if (c != '\n') {
+    return false;
+  }
+
+  bool complete = !mcu_line_overlong;
+  mcu_line[mcu_line_len] = '\0';
+  mcu_line_len = 0;
+  mcu_line_overlong = false;
+  if (complete) {
+    strcpy(out, mcu_line);
+  }
+  return complete;
+}
+
+/* hold a Pico line while the broker is unreachable; when full, the oldest is dropped */
+void queueFromMCU(const char* line) {
+  int slot = (pending_head + pending_count) % PENDING_LINES;
+  if (pending_count < PENDING_LINES) {
+    pending_count++;
+  } else {
+    pending_head = (pending_head + 1) % PENDING_LINES;
+  }
+  strncpy(pending_lines[slot], line, PENDING_LINE_SIZE - 1);
+  pending_lines[slot][PENDING_LINE_SIZE - 1] = '\0';
+}
+
+/* oldest held line into out; false if none */
+bool dequeueFromMCU(char* out) {
+  if (pending_count == 0) {
+    return false;
+  }
+  strcpy(out, pending_lines[pending_head]);
+  pending_head = (pending_head + 1) % PENDING_LINES;
+  pending_count--;
+  return true;
+}
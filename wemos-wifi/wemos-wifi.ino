@@ -23,6 +23,7 @@ Sends/receives remote MQTT messages and transmits them on Serial to pico.
 /* libraries for private data, strings */
 #include "wifi.h"
 #include "broker.h"
+#include "cbor.h"
 #include "format.h"
 
 /* libraries dictated by HiveMQ */
@@ -37,6 +38,10 @@ Sends/receives remote MQTT messages and transmits them on Serial to pico.
 #include <WiFiUdp.h>
 #include <TimeLib.h>
 
+/* fast start: cached network details, boot milestones; Pico lines */
+#include "fastboot.h"
+#include "mcu_lines.h"
+
 // A single, global CertStore which can be used by all connections.
 // Needs to stay live the entire time any of the WiFiClientBearSSLs
 // are present.
@@ -51,6 +56,8 @@ const long utcOffsetInSeconds = 7200; // UTC+02 timezone offset
 WiFiUDP ntpUDP;
 NTPClient timeClient(ntpUDP, "pool.ntp.org", utcOffsetInSeconds);
 
+BearSSL::WiFiClientSecure* bearptr;
+
 /*** mqtt and connectivity functions ***/
 void initMQTTClient(int verbose) {
   /* setting up the certificate */
@@ -64,6 +71,7 @@ void initMQTTClient(int verbose) {
   BearSSL::WiFiClientSecure *bear = new BearSSL::WiFiClientSecure();
   // Integrate the cert store with this connection
   bear->setCertStore(&certStore);
+  bearptr = bear;
 
   /* set up the client, server, and callback */
   clientptr = new PubSubClient(*bear);
@@ -80,20 +88,31 @@ void subscribeToDeviceTopics() {
   if(clientptr->subscribe(topic_device0_mode)) { 
     clientptr->publish(topic_device0_mode, "M0=0;"); // initial off-value to mode of device0
   }
+  if(clientptr->subscribe(topic_device1_value)) { 
+    clientptr->publish(topic_device1_value, "D1=0;"); // initial off-value to device1
+  }
+  clientptr->subscribe(topic_sensors_history_query); // no initial content; queries are one-off
 //  if(clientptr->subscribe(topic_device0_status)) { 
 //    clientptr->publish(topic_device0_status, "empty_status"); // initial off-value to status of device0
 //  }
 
 }
 
-void setupMQTT() {
+/* one connection attempt to the broker */
+bool connectMQTT() {
     String clientID = "WemosD1Mini-";
     clientID+=String(random(0xffff), HEX);
-    shortBlink(150);
     if (clientptr->connect(clientID.c_str(), mqtt_username, mqtt_password)) {
       Serial.println("WiFi module connected to MQTT broker");
       subscribeToDeviceTopics(); 
-    } else {
+      return true;
+    }
+    return false;
+}
+
+void setupMQTT() {
+    shortBlink(150);
+    if (!connectMQTT()) {
       Serial.print("failed, rc=");
       Serial.print(clientptr->state());
       Serial.println(" trying again in 2000 mseconds");
@@ -149,8 +168,127 @@ void setDateTime() {
   // Serial.printf("%s %s", tzname[0], asctime(&timeinfo));
 }
 
+/*** fast start bindings: fastboot.h reaches the hardware only through these ***/
+/* RTC memory first, then flash; returns false and an empty cache if neither holds one */
+bool loadBootCache(boot_cache* cache) {
+  if (ESP.rtcUserMemoryRead(BOOT_CACHE_RTC_OFFSET, (uint32_t*)cache, sizeof(boot_cache)) 
+      && bootCacheValid(cache)) {
+    return true;
+  }
+
+  File f = LittleFS.open(BOOT_CACHE_FILE, "r");
+  if (f) {
+    size_t n = f.read((uint8_t*)cache, sizeof(boot_cache));
+    f.close();
+    if (n == sizeof(boot_cache) && bootCacheValid(cache)) {
+      ESP.rtcUserMemoryWrite(BOOT_CACHE_RTC_OFFSET, (uint32_t*)cache, sizeof(boot_cache));
+      return true;
+    }
+  }
+
+  memset(cache, 0, sizeof(boot_cache));
+  return false;
+}
+
+/* RTC memory always; flash only when asked, to spare it the wear */
+void storeBootCache(boot_cache* cache, bool to_flash) {
+  bootCacheSeal(cache);
+  ESP.rtcUserMemoryWrite(BOOT_CACHE_RTC_OFFSET, (uint32_t*)cache, sizeof(boot_cache));
+
+  if (to_flash) {
+    File f = LittleFS.open(BOOT_CACHE_FILE, "w");
+    if (f) {
+      f.write((const uint8_t*)cache, sizeof(boot_cache));
+      f.close();
+    }
+  }
+}
+
+unsigned long fastStartMillis() {
+  return millis();
+}
+
+time_t fastStartNow() {
+  return time(nullptr);
+}
+
+void fastStartWiFiBegin(bool cached) {
+  WiFi.mode(WIFI_STA);
+  if (cached) {
+    if (FAST_START_STATIC_IP && bootCache.has_lease) {
+      WiFi.config(IPAddress(bootCache.ip), IPAddress(bootCache.gateway), 
+        IPAddress(bootCache.subnet), IPAddress(bootCache.dns));
+    }
+    WiFi.begin(ssid, password, bootCache.channel, bootCache.bssid, true);
+  } else {
+    WiFi.begin(ssid, password);
+  }
+}
+
+void fastStartWiFiRescan() {
+  WiFi.disconnect();
+  WiFi.config(0U, 0U, 0U);
+  WiFi.begin(ssid, password);
+}
+
+bool fastStartWiFiConnected() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+/* cache the AP and lease just associated with; flash only when they changed */
+void fastStartWiFiJoined() {
+  randomSeed(micros());
+  boot_cache previous = bootCache;
+  bootCache.channel = WiFi.channel();
+  memcpy(bootCache.bssid, WiFi.BSSID(), sizeof(bootCache.bssid));
+  bootCache.has_lease = 1;
+  bootCache.ip = (uint32_t)WiFi.localIP();
+  bootCache.gateway = (uint32_t)WiFi.gatewayIP();
+  bootCache.subnet = (uint32_t)WiFi.subnetMask();
+  bootCache.dns = (uint32_t)WiFi.dnsIP();
+
+  bool changed = !bootCacheLoaded || memcmp(&previous.channel, &bootCache.channel, 
+    offsetof(boot_cache, last_time) - offsetof(boot_cache, channel)) != 0;
+  storeBootCache(&bootCache, changed);
+  bootCacheLoaded = true;
+}
+
+bool fastStartMQTTConnect(time_t cert_time) {
+  bearptr->setX509Time(cert_time);
+  return connectMQTT();
+}
+
+bool fastStartMQTTPublish(const char* topic, const char* payload, bool retained) {
+  return clientptr->publish(topic, payload, retained);
+}
+
+const fast_start_io fastStartIO = {
+  fastStartMillis, fastStartNow, fastStartWiFiBegin, fastStartWiFiRescan, 
+  fastStartWiFiConnected, fastStartWiFiJoined, fastStartMQTTConnect, 
+  fastStartMQTTPublish, storeBootCache
+};
+
 
 /*** helpers ***/
+/* NTPClient time carries the local offset; the CBOR payloads stamp Unix time */
+unsigned long unixTime() {
+  return timeClient.getEpochTime() - utcOffsetInSeconds;
+}
+
+/* sensor datapoint as CBOR, encoded straight into cbor_msg; schema in cbor.h.
+ * publish() copies the 25 bytes into the client's buffer and sends the packet as 
+ * one TLS record. Streaming with beginPublish()/write() would skip that copy, but 
+ * BearSSL flushes every write() as a record of its own: header and payload would 
+ * go out as two, each with 20-30 bytes of record overhead */
+void publishSensorDatapointCBOR(const char* topic, unsigned long epochtime) {
+  cbor_writer w;
+  cbor_init(&w, cbor_msg, sizeof(cbor_msg));
+  cbor_sensor_datapoint(&w, epochtime, sensor_array[1], sensor_array[0], sensor_array[2]);
+  if (!w.overflow) {
+    clientptr->publish(topic, cbor_msg, w.len, true); // retain this datapoint
+  }
+}
+
 void shortBlink(int duration){
   digitalWrite(ledPin, LOW); 
   delay(duration);
@@ -166,17 +304,15 @@ void printToMCU(char* topic, byte* payload, unsigned int length) {
   Serial.println();
 }
 
-void readFromMCU() {
-    char incomingChar;
-    int i = 0;
-    while (Serial.available() > 0) {
-      incomingChar = Serial.read(); // incoming byte
-      received[i] = incomingChar;
-      i++;
-      if (incomingChar == '\n') {break;}
+/* take what the Pico has sent so far; once a line is complete, it is in 
+ * "received" with its '\n' and true is returned. See mcuLineFeed() */
+bool readFromMCU() {
+  while (Serial.available() > 0) {
+    if (mcuLineFeed(Serial.read(), received)) {
+      return true;
     }
-    received[i]='\0';
-    // return i;
+  }
+  return false;
 }
 
  /*
@@ -199,13 +335,23 @@ void callback(char* topic, byte* payload, unsigned int length) {
   }
   string[i]=0;
 
-  /* Check if payload fits protocol for a given device; for now only device0, LED
+  /* Check if payload fits protocol for a given device; device0 is the LED, device1 the digipot
    * Protocol: payloads sent to device topics, starting with 'D', contain commands. */
   if ((payload[0] == 'D')){
     int device_value = 0;
     int device_index = 0;
-    sscanf(string, device_message_format, &device_index, &device_value);
+    if (sscanf(string, device_message_format, &device_index, &device_value) != 2 
+        || device_index < 0 || device_index >= devices_online_qty) {
+      return; // no such device; the Pico drops it as well
+    }
               
+    /* a new command replaces the stamp of the previous one; a command for the 
+     * value the Pico last reported changes nothing, is not echoed and not stamped */
+    if (LATENCY_TRACE) {
+      device_command_ms[device_index] = (device_value != device_reported[device_index]) ? millis() : 0;
+      device_command_value[device_index] = device_value;
+    }
+
     // remember old state of device
     device_array_old[device_index] = device_array[device_index];
     device_array[device_index] = device_value;
@@ -228,9 +374,10 @@ void callback(char* topic, byte* payload, unsigned int length) {
  ****/
 void setup() {
   // setup serial port with same baud rate as UART on the Pico MCU
-  delay(500);
+  if (!FAST_START) {delay(500);}
+  Serial.setRxBufferSize(MSG_BUFFER_SIZE); // Pico lines pile up during a TLS handshake
   Serial.begin(115200);
-  delay(500);
+  if (!FAST_START) {delay(500);}
   
   // initialize onboard LED
   pinMode(LED_BUILTIN, OUTPUT);
@@ -238,8 +385,15 @@ void setup() {
   
   // start certification module, connect to the internet
   LittleFS.begin();
-  setupWiFi();
-  setDateTime();
+  if (FAST_START) {
+    // association, NTP and the broker complete in loop()
+    bootCacheLoaded = loadBootCache(&bootCache);
+    startWiFi(&fastStartIO);
+    configTime(TZ_Europe_Berlin, "pool.ntp.org", "time.nist.gov");
+  } else {
+    setupWiFi();
+    setDateTime();
+  }
 
   // start tracking time
   timeClient.begin();
@@ -254,51 +408,56 @@ void setup() {
 }
 
 /*
- * Infinite loop: check connection, check if anything available on UART0 Rx,
- * from the MCU, and check if the MCU message fits any template.
+ * Publish the Pico line in "received" to the topics matching its template.
  ****/
-void loop() {  
-  if (!clientptr->connected()) {
-    Serial.print("Connection dropped - reconnecting...");
-    reconnect();
-  }
-
-  /* Read from pico and publish its msgs, only if wifi+mqtt are connected. generally for sensors. */
-  if (Serial.available() > 0) {
-    
-    /* build string from Pico in "received" */
-    readFromMCU();
-
-    /* determine which topic to post Pico data to, based on format, 
-     * S%d=%f; for sensors, D%d=%d; for devices; C%d=[%s]; for comments
-     */
-    if (received[0] == 'S'){
-      int sensor_index_element = 0;
-      float sensor_value_float = 0.0;      
-      sscanf(received, sensor_message_format, &sensor_index_element, &sensor_value_float);
-       
-      // remember old reading of sensor and publish new
-      sensor_array_old[sensor_index_element] = sensor_array[sensor_index_element];
-      sensor_array[sensor_index_element] = sensor_value_float;
+void handleFromMCU() {
+  /* determine which topic to post Pico data to, based on format, 
+   * S%d=%f; for sensors, D%d=%d; for devices; C%d=[%s]; for comments
+   */
+  if (received[0] == 'S'){
+    int sensor_index_element = 0;
+    float sensor_value_float = 0.0;      
+    sscanf(received, sensor_message_format, &sensor_index_element, &sensor_value_float);
+     
+    // remember old reading of sensor and publish new
+    sensor_array_old[sensor_index_element] = sensor_array[sensor_index_element];
+    sensor_array[sensor_index_element] = sensor_value_float;
+    if (sensor_value_encoding & ENCODING_TEXT) {
       clientptr->publish(sensor_topics[sensor_index_element],received);
+    }
+    if (sensor_value_encoding & ENCODING_CBOR) {
+      timeClient.update();
+      cbor_writer w;
+      cbor_init(&w, cbor_msg, sizeof(cbor_msg));
+      cbor_sensor_value(&w, unixTime(), sensor_index_element, sensor_value_float);
+      if (!w.overflow) {
+        clientptr->publish(sensor_cbor_topics[sensor_index_element], cbor_msg, w.len);
+      }
+    }
 
-      // record which sensors updated
-      sensors_updated = (sensors_updated | (1<<sensor_index_element));
+    // record which sensors updated, and when the cycle began
+    if (sensors_updated == 0) {
+      sensor_cycle_start_ms = millis();
+    }
+    sensors_updated = (sensors_updated | (1<<sensor_index_element));
 
-      if (DEBUG) {
-        sprintf(debugging_msg, "Sensor index: [%d], sensor read value [%f], sensors_update: [%d]", 
-          sensor_index_element, sensor_value_float, sensors_updated);
-        clientptr->publish(topic_general, debugging_msg);
-      }
+    if (DEBUG) {
+      sprintf(debugging_msg, "Sensor index: [%d], sensor read value [%f], sensors_update: [%d]", 
+        sensor_index_element, sensor_value_float, sensors_updated);
+      clientptr->publish(topic_general, debugging_msg);
     }
+  }
 
-   /* build the json template with timestamp, and post to topic when all sensors refreshed */
-   if (sensors_updated == sensors_online) { 
-      sensors_updated = 0; // reset updated sensors
+ /* build the json template with timestamp, and post to topic when all sensors refreshed */
+ if (sensors_updated == sensors_online) { 
+    sensors_updated = 0; // reset updated sensors
 
-      // get time
-      timeClient.update();
-      long epochtime = timeClient.getEpochTime();
+    // get time
+    timeClient.update();
+    long epochtime = timeClient.getEpochTime();
+
+    /* text payloads; formatting the date strings is skipped when only CBOR is on */
+    if (sensor_datapoint_encoding & ENCODING_TEXT) {
       int date_day = day(epochtime);
       int date_month = month(epochtime);
       int date_year = year(epochtime);
@@ -317,37 +476,128 @@ void loop() {
       // hourly datapoint, time format 2022-07-09T12:00:00+02:00
       char formatted_time_hourly[32];
       sprintf(formatted_time_hourly, "%sT%s:00:00+%s", formatted_date, hours_s, utc_timezone);
-      sprintf(sensors_datapoint_json_msg, sensors_datapoint_json_template, formatted_time_hourly, String(epochtime), 
+      sprintf(sensors_datapoint_json_msg, sensors_datapoint_json_template, formatted_time_hourly, String(epochtime).c_str(), 
         (sensor_array[1]), temperatureunit, (sensor_array[0]), (sensor_array[2]), mobilelink, link);
       clientptr->publish(topic_sensors_datapoint_hourly, sensors_datapoint_json_msg, true); // retain this datapoint
 
       // instant datapoint
       char formatted_time_instant[32];
-      sprintf(formatted_time_instant, "%sT%s+%s", formatted_date, timeClient.getFormattedTime(), utc_timezone); 
-      sprintf(sensors_datapoint_json_msg, sensors_datapoint_json_template, formatted_time_instant, String(epochtime), 
+      sprintf(formatted_time_instant, "%sT%s+%s", formatted_date, timeClient.getFormattedTime().c_str(), utc_timezone); 
+      sprintf(sensors_datapoint_json_msg, sensors_datapoint_json_template, formatted_time_instant, String(epochtime).c_str(), 
         (sensor_array[1]), temperatureunit, (sensor_array[0]), (sensor_array[2]), mobilelink, link); 
       clientptr->publish(topic_sensors_datapoint_instant, sensors_datapoint_json_msg, true); // retain this datapoint
-     
-   }
+    }
 
-    // read echoed device commands from Pico and interpret them as devices being online 
-    if (received[0] == 'D'){
-      timeClient.update();
-      int device_index = 0;
-      int device_value = 0;
-      sscanf(received, device_message_format, &device_index, &device_value);
+    /* binary payloads, hourly stamped with the start of the hour */
+    if (sensor_datapoint_encoding & ENCODING_CBOR) {
+      unsigned long unixtime = epochtime - utcOffsetInSeconds;
+      publishSensorDatapointCBOR(topic_sensors_cbor_hourly, unixtime - (unixtime % 3600));
+      publishSensorDatapointCBOR(topic_sensors_cbor_instant, unixtime);
+    }
+
+    if (LATENCY_TRACE) {
+      sprintf(latency_msg, latency_sensor_format, millis() - sensor_cycle_start_ms);
+      clientptr->publish(topic_latency, latency_msg);
+    }
+   
+ }
+
+  // read echoed device commands from Pico and interpret them as devices being online 
+  int device_index = -1;
+  int device_value = 0;
+  if (received[0] == 'D' && sscanf(received, device_message_format, &device_index, &device_value) == 2 
+      && device_index >= 0 && device_index < devices_online_qty){
+    timeClient.update();
+    device_reported[device_index] = device_value;
+    if (device_status_encoding & ENCODING_TEXT) {
       sprintf(device_json_msg, device_json_template, device_index, device_value, timeClient.getEpochTime(),"device_state_placeholder"); 
       clientptr->publish(device_json_topics[device_index],device_json_msg, true);
-      
+    
       if (DEBUG) {
         clientptr->publish(topic_general, device_json_msg);
       }
     }
-   
+
+    if (device_status_encoding & ENCODING_CBOR) {
+      cbor_writer w;
+      cbor_init(&w, cbor_msg, sizeof(cbor_msg));
+      cbor_device(&w, unixTime(), device_index, device_value);
+      if (!w.overflow) {
+        clientptr->publish(device_cbor_topics[device_index], cbor_msg, w.len, true);
+      }
+    }
+
+    // only the echo of the stamped value closes it, not e.g. an LDR mode change
+    if (LATENCY_TRACE && device_command_ms[device_index] != 0 
+        && device_value == device_command_value[device_index]) {
+      sprintf(latency_msg, latency_device_format, device_index, millis() - device_command_ms[device_index]);
+      clientptr->publish(topic_latency, latency_msg);
+      device_command_ms[device_index] = 0;
+    }
+  }
+
+  // core1 was busy and dropped a command, which will never be echoed
+  if (LATENCY_TRACE && received[0] == 'C' && strstr(received, service_denied_comment) != NULL) {
+    for (int i = 0; i < devices_online_qty; i++) {
+      device_command_ms[i] = 0;
+    }
+  }
+
+  // per-stage latency reports of device commands from Pico
+  if (LATENCY_TRACE && received[0] == 'L') {
+    clientptr->publish(topic_latency, received);
+  }
+ 
+  /* sensor history replies go only to their own topic, they can be many */
+  if (received[0] == 'H') {
+    clientptr->publish(topic_sensors_history, received);
+  } else {
     /* publish messages from MCU to the general Pico status topic, indiscriminately */
     clientptr->publish(topic_pico_status, received);
   }
-  
+
+  bootMilestone(BOOT_FIRST_PUBLISH, &fastStartIO);
+}
+
+/*
+ * Infinite loop: check connection, check if anything available on UART0 Rx,
+ * from the MCU, and check if the MCU message fits any template.
+ ****/
+void loop() {  
+  if (FAST_START) {
+    if (!clientptr->connected()) {
+      connectStep(&fastStartIO);
+    }
+    timeStep(&fastStartIO);
+  } else if (!clientptr->connected()) {
+    Serial.print("Connection dropped - reconnecting...");
+    reconnect();
+  }
+
+  /* broker not reachable yet (fast start): keep taking lines from the Pico, 
+   * they are published in order once connected */
+  if (!clientptr->connected()) {
+    while (readFromMCU()) {
+      queueFromMCU(received);
+    }
+    delay(10);
+    return;
+  }
+
+  /* Read from pico and publish its msgs, only if wifi+mqtt are connected. generally for sensors.
+   * All held and complete lines are handled before the delay; at one line per pass, a 
+   * history backfill of 4 lines/s on top of the sensor lines would overrun the rx buffer */
+  while (dequeueFromMCU(received)) {
+    handleFromMCU();
+  }
+  while (readFromMCU()) {
+    /* a whole line from Pico in "received" */
+    handleFromMCU();
+  }
+
+  if (FAST_START) {
+    reportBoot(topic_wifi_status, &fastStartIO);
+  }
   clientptr->loop();
   delay(200);
 }
\ No newline at end of file